@@ -0,0 +1,104 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "daemon-alloc.h"
+
+#define BENCH_ALLOC_ROUNDS (1 << 20)
+
+/**
+ * @brief Allocate a block, fill it and free it the way the pool did before
+ * the allocator split: the block is cleared then overwritten
+ * @param [in] src : source of the copy
+ * @param [in] size : size bytes to allocate and copy
+ */
+static void _bench_alloc_zeroed(const void *src, size_t size)
+{
+  void *ptr = daemon_malloc(size);
+
+  memset(ptr, 0, size);
+  bench_clobber(ptr);
+  memcpy(ptr, src, size);
+  bench_clobber(ptr);
+  daemon_free(ptr);
+}
+
+/**
+ * @brief Allocate a block, fill it and free it the way the pool does now:
+ * the block is only overwritten
+ * @param [in] src : source of the copy
+ * @param [in] size : size bytes to allocate and copy
+ */
+static void _bench_alloc_plain(const void *src, size_t size)
+{
+  void *ptr = daemon_malloc(size);
+
+  memcpy(ptr, src, size);
+  bench_clobber(ptr);
+  daemon_free(ptr);
+}
+
+/**
+ * @brief Run one path and return its average cost
+ * @param [in] path : path to measure
+ * @param [in] src : source of the copy
+ * @param [in] size : size bytes to allocate and copy
+ * @param [in] rounds : number of iterations
+ * @return the average cost in nanoseconds per operation
+ */
+static double _bench_alloc_run(void (*path)(const void *, size_t),
+  const void *src, size_t size, unsigned rounds)
+{
+  uint64_t start;
+  unsigned i;
+
+  /* Warm the allocator up so the first rounds don't pay for the heap growth */
+  for (i = 0; i < rounds / 16; i++)
+    path(src, size);
+
+  start = bench_now();
+  for (i = 0; i < rounds; i++)
+    path(src, size);
+  return (double)(bench_now() - start) / rounds;
+}
+
+int main(void)
+{
+  static const size_t sizes[] = { 256, 4096, 65536 };
+  size_t i;
+  void *src;
+
+  src = daemon_malloc(sizes[sizeof(sizes) / sizeof(*sizes) - 1]);
+  memset(src, 0xa5, sizes[sizeof(sizes) / sizeof(*sizes) - 1]);
+
+  printf("%10s %16s %16s\n", "size", "memset+memcpy", "memcpy");
+  for (i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+    /* Scale the rounds down so every size runs for a similar time */
+    unsigned rounds = BENCH_ALLOC_ROUNDS / (sizes[i] / 256);
+
+    printf("%10zu %10.1f ns/op %10.1f ns/op\n", sizes[i],
+      _bench_alloc_run(_bench_alloc_zeroed, src, sizes[i], rounds),
+      _bench_alloc_run(_bench_alloc_plain, src, sizes[i], rounds));
+  }
+
+  daemon_free(src);
+  return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "daemon-loop.h"
+#include "ssl/ssl-client.h"
+#include "ssl/ssl-context.h"
+#include "ssl/ssl-server.h"
+
+#define BENCH_KTLS_CHUNK (1 << 20)
+#define BENCH_KTLS_PORT 18443
+#define BENCH_KTLS_SIZE 1024
+
+/**
+ * @brief One transfer over loopback, a client sends a file to a server
+ * accepted by the same loop
+ */
+struct s_bench_ktls {
+  struct s_loop *loop;
+  struct s_ssl_client *sender;
+  struct s_ssl_client *receiver;
+  const char *certificate;
+  int fd;
+  uint8_t ktls;
+  size_t size;
+  size_t queued;
+  size_t received;
+  int error;
+  uint64_t start;
+  uint64_t start_cpu;
+  uint64_t stop;
+  uint64_t stop_cpu;
+};
+
+/**
+ * @brief Queue file chunks until the sender is congested or everything is
+ * queued
+ * @param [in] bench: transfer to feed
+ */
+static void _bench_ktls_pump(struct s_bench_ktls *bench)
+{
+  while (bench->queued < bench->size) {
+    size_t size = bench->size - bench->queued;
+
+    if (size > BENCH_KTLS_CHUNK)
+      size = BENCH_KTLS_CHUNK;
+    int ret = s_ssl_client_sendfile(bench->sender, bench->fd, 0, size);
+    if (ret == -EAGAIN)
+      return;
+    if (ret < 0) {
+      bench->error = ret;
+      s_loop_quit(bench->loop);
+      return;
+    }
+    bench->queued += size;
+  }
+}
+
+/**
+ * @brief Congestion callback of the sender, resume once the output drained
+ * @param [in] bench: transfer concerned
+ * @param [in] state: current congestion status
+ */
+static void _bench_ktls_congestion(struct s_bench_ktls *bench,
+  enum e_ssl_congestion state)
+{
+  if (state == e_ssl_congestion_writable)
+    _bench_ktls_pump(bench);
+}
+
+/**
+ * @brief Connection callback of the sender, the clock starts there so the
+ * handshake is not measured
+ * @param [in] bench: transfer concerned
+ * @param [in] state: current connection status
+ */
+static void _bench_ktls_connection(struct s_bench_ktls *bench,
+  enum e_ssl_connection state)
+{
+  if (state != e_ssl_connection_connected) {
+    bench->error = -ECONNABORTED;
+    s_loop_quit(bench->loop);
+    return;
+  }
+  bench->start = bench_now();
+  bench->start_cpu = bench_cpu();
+  _bench_ktls_pump(bench);
+}
+
+/**
+ * @brief Connection callback of the receiver, nothing to do
+ * @param [in] bench: transfer concerned
+ * @param [in] state: current connection status
+ */
+static void _bench_ktls_accepted(struct s_bench_ktls *bench,
+  enum e_ssl_connection state)
+{
+  (void)bench;
+  (void)state;
+}
+
+/**
+ * @brief Error callback of both sides, stop the transfer
+ * @param [in] bench: transfer concerned
+ * @param [in] type: error type definition
+ * @param [in] error: error received from ssl
+ * @param [in] packet: payload concerned
+ */
+static void _bench_ktls_error(struct s_bench_ktls *bench,
+  enum e_ssl_error type, int error, const struct s_ssl_packet *packet)
+{
+  (void)type;
+  (void)packet;
+
+  bench->error = error < 0 ? error : -EIO;
+  s_loop_quit(bench->loop);
+}
+
+/**
+ * @brief Read callback of the receiver, the clock stops with the last byte
+ * @param [in] bench: transfer concerned
+ * @param [in] view: view over the received data
+ */
+static void _bench_ktls_view(struct s_bench_ktls *bench,
+  struct s_ssl_view *view)
+{
+  size_t size = s_ssl_view_get_size(view);
+
+  s_ssl_view_consume(view, size);
+  bench->received += size;
+  if (bench->received >= bench->size) {
+    bench->stop = bench_now();
+    bench->stop_cpu = bench_cpu();
+    s_loop_quit(bench->loop);
+  }
+}
+
+static const struct s_ssl_funcs _s_bench_ktls_sender = {
+  .congestion = (s_ssl_congestion_cbk)_bench_ktls_congestion,
+  .connection = (s_ssl_connection_cbk)_bench_ktls_connection,
+  .error = (s_ssl_error_cbk)_bench_ktls_error,
+  .view = (s_ssl_view_cbk)_bench_ktls_view,
+};
+
+static const struct s_ssl_funcs _s_bench_ktls_receiver = {
+  .connection = (s_ssl_connection_cbk)_bench_ktls_accepted,
+  .error = (s_ssl_error_cbk)_bench_ktls_error,
+  .view = (s_ssl_view_cbk)_bench_ktls_view,
+};
+
+/**
+ * @brief Accept callback of the server, the receiver uses kTLS like the sender
+ * @param [in] bench: transfer concerned
+ * @param [in] loop: loop of the server
+ * @param [in] address: address of the sender
+ * @return a client without connection on success, NULL on error
+ */
+static struct s_ssl_client *_bench_ktls_accept(struct s_bench_ktls *bench,
+  struct s_loop *loop, const struct sockaddr_storage *address)
+{
+  (void)address;
+
+  bench->receiver = s_ssl_client_new(loop, &_s_bench_ktls_receiver, bench);
+  if (bench->receiver && bench->ktls)
+    s_ssl_client_set_ktls(bench->receiver, 1);
+  return bench->receiver;
+}
+
+/**
+ * @brief Send the whole transfer and print its throughput and cost
+ * @param [in] bench: transfer to run
+ * @param [in] address: address of the server
+ * @return 0 on success, an -errno value on error
+ */
+static int _bench_ktls_run(struct s_bench_ktls *bench,
+  const struct sockaddr_storage *address)
+{
+  struct s_ssl_client_stats stats;
+  int ret;
+
+  bench->sender = s_ssl_client_new(bench->loop, &_s_bench_ktls_sender, bench);
+  if (!bench->sender)
+    return -ENOMEM;
+
+  /* one chunk in flight at most, so every chunk can go through the kernel */
+  ret = s_ssl_client_set_watermarks(bench->sender, 0, 1);
+  if (ret == 0 && bench->ktls)
+    ret = s_ssl_client_set_ktls(bench->sender, 1);
+  if (ret == 0)
+    ret = s_ssl_client_connect(bench->sender, bench->certificate, address, 1);
+  if (ret == 0)
+    s_loop_run(bench->loop);
+  if (ret == 0)
+    ret = bench->error;
+
+  if (ret == 0 && s_ssl_client_get_stats(bench->sender, &stats) == 0) {
+    double seconds = (bench->stop - bench->start) / 1e9;
+    double gigabytes = bench->size / 1e9;
+
+    printf("%6s %6d %10.1f %10.2f %9.1f%%\n",
+      bench->ktls ? "on" : "off", s_ssl_client_is_ktls(bench->sender),
+      bench->size / 1e6 / seconds,
+      (bench->stop_cpu - bench->start_cpu) / 1e9 / gigabytes,
+      100.0 * stats.offloaded / bench->size);
+  }
+
+  s_ssl_client_free(bench->sender);
+  s_ssl_client_free(bench->receiver);
+  bench->sender = NULL;
+  bench->receiver = NULL;
+  return ret;
+}
+
+/**
+ * @brief Create the file sent by every transfer, one chunk long
+ * @return a file descriptor on success, an -errno value on error
+ */
+static int _bench_ktls_file(void)
+{
+  char path[] = "/tmp/cerebellum-bench-XXXXXX";
+  uint8_t *chunk;
+  int fd;
+
+  fd = mkstemp(path);
+  if (fd < 0)
+    return -errno;
+  unlink(path);
+
+  chunk = daemon_malloc(BENCH_KTLS_CHUNK);
+  memset(chunk, 0xa5, BENCH_KTLS_CHUNK);
+  if (write(fd, chunk, BENCH_KTLS_CHUNK) != BENCH_KTLS_CHUNK) {
+    daemon_free(chunk);
+    close(fd);
+    return -EIO;
+  }
+  daemon_free(chunk);
+  return fd;
+}
+
+int main(int argc, char *argv[])
+{
+  struct s_bench_ktls bench = { .fd = -1 };
+  struct sockaddr_storage address = { 0 };
+  struct sockaddr_in *in = (struct sockaddr_in *)&address;
+  struct s_ssl_server *server = NULL;
+  int ret;
+
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <certificate> <private key> [megabytes]\n",
+      argv[0]);
+    return EXIT_FAILURE;
+  }
+  bench.certificate = argv[1];
+  bench.size = (size_t)BENCH_KTLS_SIZE << 20;
+  if (argc > 3) {
+    char *end = NULL;
+    unsigned long megabytes;
+
+    errno = 0;
+    megabytes = strtoul(argv[3], &end, 10);
+    if (errno || end == argv[3] || *end || !megabytes ||
+        megabytes > (SIZE_MAX >> 20)) {
+      fprintf(stderr, "invalid size '%s'\n", argv[3]);
+      return EXIT_FAILURE;
+    }
+    bench.size = (size_t)megabytes << 20;
+  }
+
+  in->sin_family = AF_INET;
+  in->sin_port = htons(BENCH_KTLS_PORT);
+  in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  bench.loop = s_loop_new();
+  if (!bench.loop || s_ssl_library_init() < 0)
+    return EXIT_FAILURE;
+
+  ret = _bench_ktls_file();
+  if (ret >= 0) {
+    bench.fd = ret;
+    server = s_ssl_server_new(bench.loop, argv[1], argv[2],
+      (s_ssl_accept_cbk)_bench_ktls_accept, &bench);
+    ret = server ? s_ssl_server_listen(server, &address) : -ENOMEM;
+  }
+
+  if (ret == 0) {
+    printf("%6s %6s %10s %10s %10s\n", "ktls", "active", "MB/s",
+      "cpu s/GB", "offloaded");
+    ret = _bench_ktls_run(&bench, &address);
+  }
+  /* the second pass is skipped when the ssl library has no kTLS at all */
+  if (ret == 0) {
+    bench.ktls = 1;
+    bench.queued = 0;
+    bench.received = 0;
+    ret = _bench_ktls_run(&bench, &address);
+    if (ret == -ENOTSUP)
+      ret = 0;
+  }
+  if (ret < 0)
+    fprintf(stderr, "benchmark failed: %s\n", strerror(-ret));
+
+  if (server)
+    s_ssl_server_free(server);
+  if (bench.fd >= 0)
+    close(bench.fd);
+  s_ssl_library_deinit();
+  s_loop_free(bench.loop);
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,59 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BENCH_H_
+# define _BENCH_H_
+
+# include <stdint.h>
+# include <stdio.h>
+# include <time.h>
+
+/**
+ * @brief Read the monotonic clock
+ * @return the current time in nanoseconds
+ */
+static inline uint64_t bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Read the CPU time consumed by the whole process
+ * @return the CPU time in nanoseconds
+ */
+static inline uint64_t bench_cpu(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Keep the compiler from dropping a computation whose result is
+ * unused
+ * @param [in] ptr : memory written by the measured code
+ */
+static inline void bench_clobber(void *ptr)
+{
+  __asm__ __volatile__("" : : "g"(ptr) : "memory");
+}
+
+#endif /* !_BENCH_H_ */
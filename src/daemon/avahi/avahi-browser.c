@@ -16,112 +16,575 @@
  */
 
 #include <avahi-client/lookup.h>
+#include <inttypes.h>
 #include <libdaemon/dlog.h>
+#include <strings.h>
+#include <time.h>
 #include "avahi-browser.h"
 #include "daemon-alloc.h"
 #include "daemon-cond.h"
+#include "daemon-hash.h"
 
-struct s_browser_data *s_browser_data_new(const char *address,
-  const char *domain, const char *name, uint16_t port, const char *txt,
-  const char *type)
+/**
+ * @brief Copy a string at a specific position of a browser data block
+ * @param [in] str: string to copy, can be NULL
+ * @param [in, out] cursor: position in the block, moved after the copy
+ * @return the copy, NULL if the string is NULL
+ */
+static char *_s_browser_data_copy(const char *str, char **cursor)
+{
+  if (!str)
+    return NULL;
+
+  size_t size = strlen(str) + 1;
+  char *copy = memcpy(*cursor, str, size);
+  *cursor += size;
+  return copy;
+}
+
+struct s_browser_data *s_browser_data_new(
+  const struct s_browser_address *addresses, uint32_t address_count,
+  const char *domain, const char *name, uint16_t port,
+  const struct s_browser_txt *txt, uint32_t txt_count, const char *type)
 {
-  struct s_browser_data *data = daemon_malloc(sizeof(struct s_browser_data));
-  data->address = address ? strdup(address) : NULL;
-  data->domain = domain ? strdup(domain) : NULL;
-  data->name = name ? strdup(name) : NULL;
+  /* the structure, its txt pairs, its addresses and its strings share a
+   * single block from the loop pool */
+  const char *strings[] = { domain, name, type };
+  size_t size = sizeof(struct s_browser_data) +
+    txt_count * sizeof(struct s_browser_txt) +
+    address_count * sizeof(struct s_browser_address);
+  for (uint32_t i = 0; i < sizeof(strings) / sizeof(strings[0]); ++i)
+    size += strings[i] ? strlen(strings[i]) + 1 : 0;
+  for (uint32_t i = 0; i < txt_count; ++i)
+    size += strlen(txt[i].key) + strlen(txt[i].value) + 2;
+
+  struct s_browser_data *data = daemon_pool_alloc(size);
+  data->txt = (struct s_browser_txt *)(data + 1);
+  data->addresses = (struct s_browser_address *)(data->txt + txt_count);
+  if (address_count)
+    memcpy(data->addresses, addresses, address_count * sizeof(*addresses));
+  data->address_count = address_count;
+  char *cursor = (char *)(data->addresses + address_count);
+  data->domain = _s_browser_data_copy(domain, &cursor);
+  data->name = _s_browser_data_copy(name, &cursor);
   data->port = port;
-  data->txt = txt ? strdup(txt) : NULL;
-  data->type = type ? strdup(type) : NULL;
+  for (uint32_t i = 0; i < txt_count; ++i) {
+    data->txt[i].key = _s_browser_data_copy(txt[i].key, &cursor);
+    data->txt[i].value = _s_browser_data_copy(txt[i].value, &cursor);
+  }
+  data->txt_count = txt_count;
+  data->type = _s_browser_data_copy(type, &cursor);
   return data;
 }
 
+const char *s_browser_data_get_txt(const struct s_browser_data *data,
+  const char *key)
+{
+  daemon_return_val_if_fail(data, NULL);
+  daemon_return_val_if_fail(key, NULL);
+
+  /* the keys of a txt record are case insensitive */
+  for (uint32_t i = 0; i < data->txt_count; ++i) {
+    if (strcasecmp(data->txt[i].key, key) == 0)
+      return data->txt[i].value;
+  }
+  return NULL;
+}
+
 void s_browser_data_free(struct s_browser_data *data)
 {
   daemon_return_if_fail(data);
 
-  if (data->address)
-    daemon_free(data->address);
-  if (data->domain)
-    daemon_free(data->domain);
-  if (data->name)
-    daemon_free(data->name);
-  if (data->txt)
-    daemon_free(data->txt);
-  if (data->type)
-    daemon_free(data->type);
-  daemon_free(data);
+  daemon_pool_free(data);
 }
 
+/**
+ * @brief Lifetime of a resolved service in seconds, after which a new
+ * instance is resolved again. Matches the default TTL of the avahi records
+ */
+#define BROWSER_TTL 120
+
+/**
+ * @brief Number of address families resolved for a service
+ */
+#define BROWSER_FAMILIES 2
+
+/**
+ * @brief Address family resolved in each slot of an entry, IPv6 first as it
+ * is the first one tried when connecting
+ */
+static const AvahiProtocol _g_browser_families[BROWSER_FAMILIES] = {
+  AVAHI_PROTO_INET6, AVAHI_PROTO_INET
+};
+
 struct s_browser {
   AvahiServiceBrowser *browser;
   struct s_service_data *data;
   struct s_browser_funcs funcs;
+  struct s_hash *registry;
+  struct s_browser_stats stats;
   void *userdata;
 };
 
+/**
+ * @brief Service known by a browser, shared by every interface and protocol
+ * announcing it
+ */
+struct s_browser_entry {
+  struct s_browser_address addresses[BROWSER_FAMILIES];
+  struct s_browser *browser;
+  char *domain;
+  uint64_t expires;
+  uint8_t failures;
+  uint8_t found;
+  uint32_t instances;
+  char *name;
+  uint8_t notified;
+  uint16_t port;
+  AvahiServiceResolver *resolvers[BROWSER_FAMILIES];
+  struct s_browser_txt *txt;
+  uint32_t txt_count;
+  char *type;
+};
+
 /* codecheck_ignore[COMPLEX_MACRO] */
 #define _s_browser_min(str1, str2) \
   (strlen(str1) < strlen(str2)) ? strlen(str1) : strlen(str2)
 
+/**
+ * @brief Get the monotonic time used for the registry expiration
+ * @return the time in seconds
+ */
+static uint64_t _s_browser_now(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec;
+}
+
+/**
+ * @brief Build the registry key of a service
+ * @param [in] name: name of the service
+ * @param [in] type: type of the service
+ * @param [in] domain: domain of the service
+ * @return the key, to release with #daemon_free
+ */
+static char *_s_browser_key(const char *name, const char *type,
+  const char *domain)
+{
+  size_t size = strlen(name) + strlen(type) + strlen(domain) + 3;
+  char *key = daemon_malloc(size);
+  snprintf(key, size, "%s.%s.%s", name, type, domain);
+  return key;
+}
+
+/**
+ * @brief Allocate a registry entry, the strings share its block
+ * @param [in] browser: browser owning the entry
+ * @param [in] name: name of the service
+ * @param [in] type: type of the service
+ * @param [in] domain: domain of the service
+ * @return a valid pointer
+ */
+static struct s_browser_entry *_s_browser_entry_new(struct s_browser *browser,
+  const char *name, const char *type, const char *domain)
+{
+  size_t size = sizeof(struct s_browser_entry) + strlen(name) +
+    strlen(type) + strlen(domain) + 3;
+  struct s_browser_entry *entry = daemon_zalloc(size);
+  char *cursor = (char *)(entry + 1);
+  entry->browser = browser;
+  entry->domain = _s_browser_data_copy(domain, &cursor);
+  entry->name = _s_browser_data_copy(name, &cursor);
+  entry->type = _s_browser_data_copy(type, &cursor);
+  return entry;
+}
+
+/**
+ * @brief Deallocate a registry entry and cancel its pending resolutions
+ * @param [in] entry: entry to delete
+ */
+static void _s_browser_entry_free(struct s_browser_entry *entry)
+{
+  daemon_return_if_fail(entry);
+
+  for (uint32_t i = 0; i < BROWSER_FAMILIES; ++i) {
+    if (entry->resolvers[i])
+      avahi_service_resolver_free(entry->resolvers[i]);
+  }
+  if (entry->txt)
+    daemon_free(entry->txt);
+  daemon_free(entry);
+}
+
+/**
+ * @brief Check if an item of a txt record can be parsed, an item without key
+ * is ignored
+ * @param [in] item: item to check
+ * @return 1 if the item is valid, 0 otherwise
+ */
+static uint8_t _s_browser_txt_valid(AvahiStringList *item)
+{
+  return avahi_string_list_get_size(item) > 0 &&
+    avahi_string_list_get_text(item)[0] != '=';
+}
+
+/**
+ * @brief Parse a txt record into key/value pairs sharing a single block. A key
+ * without value, a boolean attribute, gets an empty value
+ * @param [in] list: txt record to parse
+ * @param [out] count: number of pairs
+ * @return the pairs to release with #daemon_free, NULL if there is none
+ */
+static struct s_browser_txt *_s_browser_txt_parse(AvahiStringList *list,
+  uint32_t *count)
+{
+  AvahiStringList *item;
+  size_t size = 0;
+
+  *count = 0;
+  for (item = list; item; item = avahi_string_list_get_next(item)) {
+    if (!_s_browser_txt_valid(item))
+      continue;
+    size += avahi_string_list_get_size(item) + 1;
+    (*count)++;
+  }
+  if (!*count)
+    return NULL;
+
+  struct s_browser_txt *txt = daemon_malloc(*count * sizeof(*txt) + size);
+  char *cursor = (char *)(txt + *count);
+  uint32_t i = 0;
+  for (item = list; item; item = avahi_string_list_get_next(item)) {
+    if (!_s_browser_txt_valid(item))
+      continue;
+
+    size_t length = avahi_string_list_get_size(item);
+    memcpy(cursor, avahi_string_list_get_text(item), length);
+    cursor[length] = '\0';
+
+    char *separator = memchr(cursor, '=', length);
+    txt[i].key = cursor;
+    txt[i].value = separator ? separator + 1 : cursor + length;
+    if (separator)
+      *separator = '\0';
+    cursor += length + 1;
+    ++i;
+  }
+  return txt;
+}
+
+/**
+ * @brief Compare two parsed txt records
+ * @return 1 if both records hold the same pairs in the same order, 0
+ * otherwise
+ */
+static uint8_t _s_browser_txt_equal(const struct s_browser_txt *txt1,
+  uint32_t count1, const struct s_browser_txt *txt2, uint32_t count2)
+{
+  if (count1 != count2)
+    return 0;
+
+  for (uint32_t i = 0; i < count1; ++i) {
+    if (strcmp(txt1[i].key, txt2[i].key) != 0 ||
+        strcmp(txt1[i].value, txt2[i].value) != 0)
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Update an entry with the resolution result of an address family
+ * @param [in] entry: entry to update
+ * @param [in] slot: slot of the address family
+ * @param [in] address: resolved address
+ * @param [in] port: resolved port
+ * @param [in] txt: resolved txt pairs, owned by the entry afterwards
+ * @param [in] txt_count: number of txt pairs
+ * @return 1 if the entry changed, 0 otherwise
+ */
+static uint8_t _s_browser_entry_update(struct s_browser_entry *entry,
+  uint32_t slot, const struct s_browser_address *address, uint16_t port,
+  struct s_browser_txt *txt, uint32_t txt_count)
+{
+  struct s_browser_address *current = &entry->addresses[slot];
+  uint8_t changed = !entry->found || entry->port != port ||
+    current->interface != address->interface ||
+    strcmp(current->address, address->address) != 0 ||
+    !_s_browser_txt_equal(entry->txt, entry->txt_count, txt, txt_count);
+
+  entry->expires = _s_browser_now() + BROWSER_TTL;
+  entry->found = 1;
+  if (!changed) {
+    if (txt)
+      daemon_free(txt);
+    return 0;
+  }
+
+  *current = *address;
+  entry->port = port;
+  if (entry->txt)
+    daemon_free(entry->txt);
+  entry->txt = txt;
+  entry->txt_count = txt_count;
+  return 1;
+}
+
+/**
+ * @brief Forget the address of a family which failed to resolve, the service
+ * may have left this network
+ * @param [in] entry: entry to update
+ * @param [in] slot: slot of the address family
+ * @return 1 if the entry changed, 0 otherwise
+ */
+static uint8_t _s_browser_entry_clear(struct s_browser_entry *entry,
+  uint32_t slot)
+{
+  struct s_browser_address *current = &entry->addresses[slot];
+
+  if (current->address[0] == '\0')
+    return 0;
+  memset(current, 0, sizeof(*current));
+  return 1;
+}
+
+/**
+ * @brief Gather the resolved addresses of an entry, IPv6 first
+ * @param [in] entry: entry to browse
+ * @param [out] addresses: resolved addresses, #BROWSER_FAMILIES at most
+ * @return the number of addresses
+ */
+static uint32_t _s_browser_entry_addresses(const struct s_browser_entry *entry,
+  struct s_browser_address *addresses)
+{
+  uint32_t count = 0;
+
+  for (uint32_t i = 0; i < BROWSER_FAMILIES; ++i) {
+    if (entry->addresses[i].address[0] != '\0')
+      addresses[count++] = entry->addresses[i];
+  }
+  return count;
+}
+
+/**
+ * @brief Notify the removal of a service previously found
+ * @param [in] entry: entry of the service
+ */
+static void _s_browser_entry_remove(struct s_browser_entry *entry)
+{
+  struct s_browser *browser = entry->browser;
+  struct s_browser_data data = {
+    .addresses = NULL,
+    .address_count = 0,
+    .domain = entry->domain,
+    .name = entry->name,
+    .port = 0,
+    .txt = NULL,
+    .txt_count = 0,
+    .type = entry->type
+  };
+
+  entry->notified = 0;
+  browser->funcs.remove(browser->userdata, &data);
+}
+
+/**
+ * @brief Notify a changed service, unless the filter of the browser rejects
+ * it. A service found earlier and rejected now, or left without address, is
+ * removed
+ * @param [in] entry: entry of the service
+ */
+static void _s_browser_entry_notify(struct s_browser_entry *entry)
+{
+  struct s_browser_address addresses[BROWSER_FAMILIES];
+  struct s_browser *browser = entry->browser;
+  uint32_t count = _s_browser_entry_addresses(entry, addresses);
+  struct s_browser_data data = {
+    .addresses = addresses,
+    .address_count = count,
+    .domain = entry->domain,
+    .name = entry->name,
+    .port = entry->port,
+    .txt = entry->txt,
+    .txt_count = entry->txt_count,
+    .type = entry->type
+  };
+
+  if (!count) {
+    if (entry->notified)
+      _s_browser_entry_remove(entry);
+    return;
+  }
+  if (browser->funcs.filter &&
+      browser->funcs.filter(browser->userdata, &data) != 0) {
+    browser->stats.filtered++;
+    if (entry->notified)
+      _s_browser_entry_remove(entry);
+    return;
+  }
+
+  browser->stats.changes++;
+  entry->notified = 1;
+  browser->funcs.find(browser->userdata, s_browser_data_new(addresses, count,
+    entry->domain, entry->name, entry->port, entry->txt, entry->txt_count,
+    entry->type));
+}
+
 static void _s_browser_resolver_cbk(AvahiServiceResolver *resolver,
-  daemon_unused AvahiIfIndex interface, daemon_unused AvahiProtocol protocol,
-  AvahiResolverEvent event, const char *name, const char *type,
-  const char *domain, daemon_unused const char *host_name,
-  const AvahiAddress *address, uint16_t port, AvahiStringList *txt,
-  daemon_unused AvahiLookupResultFlags flags, struct s_browser *browser)
+  AvahiIfIndex interface, daemon_unused AvahiProtocol protocol,
+  AvahiResolverEvent event, daemon_unused const char *name,
+  daemon_unused const char *type, daemon_unused const char *domain,
+  daemon_unused const char *host_name, const AvahiAddress *address,
+  uint16_t port, AvahiStringList *txt,
+  daemon_unused AvahiLookupResultFlags flags, struct s_browser_entry *entry)
 {
-  daemon_return_if_fail(browser);
+  daemon_return_if_fail(entry);
 
+  struct s_browser *browser = entry->browser;
   AvahiClient *client = avahi_service_resolver_get_client(resolver);
+  int error = avahi_client_errno(client);
+  uint32_t slot = 0;
+
+  while (slot < BROWSER_FAMILIES && entry->resolvers[slot] != resolver)
+    ++slot;
+  daemon_return_if_fail(slot < BROWSER_FAMILIES);
+
+  /* one shot resolution, the next instance of the service starts another
+   * one once the entry expired */
+  entry->resolvers[slot] = NULL;
+  avahi_service_resolver_free(resolver);
+
   /* Called whenever a service has been resolved successfully or timed out */
   switch (event) {
   case AVAHI_RESOLVER_FAILURE:
-    browser->funcs.failure(browser->userdata, avahi_client_errno(client));
+    /* a service without address in one family is still reachable in the
+     * other one */
+    if (++entry->failures == BROWSER_FAMILIES)
+      browser->funcs.failure(browser->userdata, error);
+    if (_s_browser_entry_clear(entry, slot))
+      _s_browser_entry_notify(entry);
     break;
-  case AVAHI_RESOLVER_FOUND:
-    if (strncmp(name, "cerebellum", _s_browser_min(name, "cerebellum")) == 0) {
-      char addr_str[AVAHI_ADDRESS_STR_MAX] = { 0, };
-      avahi_address_snprint(addr_str, sizeof(*address), address);
-      char *txt_str = avahi_string_list_to_string(txt);
-      browser->funcs.find(browser->userdata, s_browser_data_new(addr_str,
-        domain, name, port, txt_str, type));
-      daemon_free(txt_str);
+  case AVAHI_RESOLVER_FOUND: {
+    struct s_browser_address resolved = { .interface = interface };
+    uint32_t txt_count;
+
+    avahi_address_snprint(resolved.address, sizeof(resolved.address),
+      address);
+    struct s_browser_txt *pairs = _s_browser_txt_parse(txt, &txt_count);
+    if (!_s_browser_entry_update(entry, slot, &resolved, port, pairs,
+        txt_count)) {
+      browser->stats.unchanged++;
+      break;
     }
+    _s_browser_entry_notify(entry);
     break;
   }
-  avahi_service_resolver_free(resolver);
+  }
+}
+
+/**
+ * @brief Handle a new instance of a service, resolve its IPv6 and IPv4
+ * addresses unless a resolution is already running or its last result did
+ * not expire yet
+ * @param [in] browser: browser receiving the instance
+ * @param [in] client: avahi client of the browser
+ * @param [in] interface: interface of the instance
+ * @param [in] protocol: protocol of the instance
+ * @param [in] name: name of the service
+ * @param [in] type: type of the service
+ * @param [in] domain: domain of the service
+ */
+static void _s_browser_new(struct s_browser *browser, AvahiClient *client,
+  AvahiIfIndex interface, AvahiProtocol protocol, const char *name,
+  const char *type, const char *domain)
+{
+  if (strncmp(name, "cerebellum", _s_browser_min(name, "cerebellum")) != 0)
+    return;
+
+  char *key = _s_browser_key(name, type, domain);
+  struct s_browser_entry *entry = s_hash_lookup(browser->registry, key);
+  if (!entry) {
+    entry = _s_browser_entry_new(browser, name, type, domain);
+    /* an instance without entry is not tracked, it is browsed again later */
+    if (s_hash_insert(browser->registry, key, entry) < 0) {
+      daemon_log(LOG_ERR, "failed to register the service '%s'\n", name);
+      _s_browser_entry_free(entry);
+      daemon_free(key);
+      return;
+    }
+  }
+  daemon_free(key);
+
+  entry->instances++;
+  if (entry->resolvers[0] || entry->resolvers[1]) {
+    browser->stats.deduped++;
+    return;
+  }
+  if (entry->found && _s_browser_now() < entry->expires) {
+    browser->stats.cached++;
+    return;
+  }
+
+  browser->stats.resolves++;
+  entry->failures = 0;
+  for (uint32_t i = 0; i < BROWSER_FAMILIES; ++i) {
+    entry->resolvers[i] = avahi_service_resolver_new(client, interface,
+      protocol, name, type, domain, _g_browser_families[i], 0,
+      (AvahiServiceResolverCallback)_s_browser_resolver_cbk, entry);
+    if (!entry->resolvers[i])
+      entry->failures++;
+  }
+  if (entry->failures == BROWSER_FAMILIES)
+    browser->funcs.failure(browser->userdata, avahi_client_errno(client));
+}
+
+/**
+ * @brief Handle the removal of an instance of a service, the service is only
+ * removed along with its last instance
+ * @param [in] browser: browser losing the instance
+ * @param [in] name: name of the service
+ * @param [in] type: type of the service
+ * @param [in] domain: domain of the service
+ */
+static void _s_browser_remove(struct s_browser *browser, const char *name,
+  const char *type, const char *domain)
+{
+  char *key = _s_browser_key(name, type, domain);
+  struct s_browser_entry *entry = s_hash_lookup(browser->registry, key);
+  if (!entry || --entry->instances > 0)
+    goto end;
+
+  if (entry->notified)
+    _s_browser_entry_remove(entry);
+  s_hash_remove(browser->registry, key);
+
+end:
+  daemon_free(key);
 }
 
 static void _s_browser_cbk(AvahiServiceBrowser *avahi_browser,
   AvahiIfIndex interface, AvahiProtocol protocol, AvahiBrowserEvent event,
   const char *name, const char *type, const char *domain,
-  daemon_unused AvahiLookupResultFlags flags, struct s_browser *browser)
+  AvahiLookupResultFlags flags, struct s_browser *browser)
 {
   daemon_return_if_fail(browser);
 
+  /* the service published by this client is not a peer */
+  if (flags & AVAHI_LOOKUP_RESULT_OUR_OWN)
+    return;
+
   AvahiClient *client = avahi_service_browser_get_client(avahi_browser);
   switch (event) {
   case AVAHI_BROWSER_FAILURE:
     browser->funcs.failure(browser->userdata, avahi_client_errno(client));
     break;
   case AVAHI_BROWSER_NEW:
-    if (!avahi_service_resolver_new(client, interface, protocol, name, type,
-          domain, AVAHI_PROTO_UNSPEC, 0,
-          (AvahiServiceResolverCallback)_s_browser_resolver_cbk, browser))
-        browser->funcs.failure(browser->userdata, avahi_client_errno(client));
+    _s_browser_new(browser, client, interface, protocol, name, type, domain);
     break;
-  case AVAHI_BROWSER_REMOVE: {
-    struct s_browser_data data = {
-      .address = NULL,
-      .domain = (char *)domain,
-      .name = (char *)name,
-      .port = 0,
-      .txt = NULL,
-      .type = (char *)type
-    };
-    browser->funcs.remove(browser->userdata, &data);
+  case AVAHI_BROWSER_REMOVE:
+    _s_browser_remove(browser, name, type, domain);
     break;
-  }
   case AVAHI_BROWSER_ALL_FOR_NOW:
   case AVAHI_BROWSER_CACHE_EXHAUSTED:
     break;
@@ -136,15 +599,18 @@ struct s_browser *s_browser_new(struct s_client *client,
   daemon_return_val_if_fail(data, NULL);
   daemon_return_val_if_fail(funcs, NULL);
 
-  struct s_browser *browser = daemon_malloc(sizeof(struct s_browser));
+  struct s_browser *browser = daemon_zalloc(sizeof(struct s_browser));
   AvahiClient *avahi_client = s_client_toavahi(client);
   browser->data = data;
   browser->funcs = *funcs;
+  browser->registry = s_hash_new((s_hash_free_cbk)_s_browser_entry_free);
   browser->userdata = userdata;
+  if (!browser->registry)
+    goto error;
+
   browser->browser = avahi_service_browser_new(avahi_client, data->interface,
     data->protocol, data->type, NULL, 0,
     (AvahiServiceBrowserCallback)_s_browser_cbk, browser);
-
   if (!browser->browser)
     goto error;
 
@@ -156,11 +622,30 @@ error:
   return NULL;
 }
 
+int s_browser_get_stats(const struct s_browser *browser,
+  struct s_browser_stats *stats)
+{
+  daemon_return_val_if_fail(browser, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
+
+  *stats = browser->stats;
+  return 0;
+}
+
 void s_browser_free(struct s_browser *browser)
 {
   daemon_return_if_fail(browser);
 
-  avahi_service_browser_free(browser->browser);
+  daemon_log(LOG_INFO, "browser: %" PRIu64 " resolves, %" PRIu64 " deduped, %"
+    PRIu64 " cached, %" PRIu64 " changes, %" PRIu64 " unchanged, %" PRIu64
+    " filtered\n", browser->stats.resolves, browser->stats.deduped,
+    browser->stats.cached, browser->stats.changes, browser->stats.unchanged,
+    browser->stats.filtered);
+  /* the pending resolutions are cancelled along with the registry */
+  if (browser->registry)
+    s_hash_free(browser->registry);
+  if (browser->browser)
+    avahi_service_browser_free(browser->browser);
   s_service_free(browser->data);
   daemon_free(browser);
 }
@@ -19,20 +19,53 @@
 # define _AVAHI_AVAHI_BROWSER_H_
 
 # include <avahi-client/client.h>
+# include <avahi-common/address.h>
 # include "avahi-client.h"
 # include "avahi-service.h"
 
 struct s_browser;
 
 /**
- * @brief Cerebellum data description
+ * @brief Browser counters
+ */
+struct s_browser_stats {
+  uint64_t cached;
+  uint64_t changes;
+  uint64_t deduped;
+  uint64_t filtered;
+  uint64_t resolves;
+  uint64_t unchanged;
+};
+
+/**
+ * @brief Key/value pair of a txt record, a key without value has an empty
+ * value
+ */
+struct s_browser_txt {
+  char *key;
+  char *value;
+};
+
+/**
+ * @brief Resolved address of a service
+ */
+struct s_browser_address {
+  char address[AVAHI_ADDRESS_STR_MAX];
+  int interface;
+};
+
+/**
+ * @brief Cerebellum data description, a service reachable over IPv6 and IPv4
+ * has an address per family, IPv6 first
  */
 struct s_browser_data {
-  char *address;
+  struct s_browser_address *addresses;
+  uint32_t address_count;
   char *domain;
   char *name;
   uint16_t port;
-  char *txt;
+  struct s_browser_txt *txt;
+  uint32_t txt_count;
   char *type;
 };
 
@@ -40,9 +73,20 @@ struct s_browser_data {
  * @brief Allocate a new browser data instance
  * @return a valid pointer on success, NULL on error
  */
-struct s_browser_data *s_browser_data_new(const char *address,
-  const char *domain, const char *name, uint16_t port, const char *txt,
-  const char *type);
+struct s_browser_data *s_browser_data_new(
+  const struct s_browser_address *addresses, uint32_t address_count,
+  const char *domain, const char *name, uint16_t port,
+  const struct s_browser_txt *txt, uint32_t txt_count, const char *type);
+
+/**
+ * @brief Get the value of a txt record key, the keys are case insensitive
+ * @param [in] data: service data to browse
+ * @param [in] key: key to look for
+ * @return the value, an empty string for a key without value, NULL if the key
+ * is missing
+ */
+const char *s_browser_data_get_txt(const struct s_browser_data *data,
+  const char *key);
 
 /**
  * @brief Deallocate a specific browser data instance
@@ -76,14 +120,29 @@ typedef void (*s_browser_failure_cbk)(void *userdata, int error);
 typedef void (*s_browser_find_cbk)(void *userdata,
   struct s_browser_data *data);
 
+/**
+ * @brief Call before a service is found to select the services worth a
+ * connection, optional
+ * @param [in] userdata: userdata passing through the allocation
+ * @param [in] data: service data to check
+ * @return 0 to accept the service, other value otherwise
+ */
+typedef int (*s_browser_filter_cbk)(void *userdata,
+  const struct s_browser_data *data);
+
 struct s_browser_funcs {
   s_browser_failure_cbk failure;
+  s_browser_filter_cbk filter;
   s_browser_find_cbk find;
   s_browser_remove_cbk remove;
 };
 
 /**
- * @brief Allocate a new group
+ * @brief Allocate a new browser. The services are kept in a registry: a
+ * service announced on several interfaces or protocols is resolved once per
+ * address family, its result is cached for a while and @funcs find is only
+ * called when it changed, the first family resolved does not wait for the
+ * other one
  * @param [in] client: client structure
  * @param [in] data: service description
  * @param [in] funcs: functions behavior description
@@ -94,6 +153,15 @@ struct s_browser *s_browser_new(struct s_client *client,
   struct s_service_data *data, const struct s_browser_funcs *funcs,
   void *userdata);
 
+/**
+ * @brief Get the counters of a browser
+ * @param [in] browser: browser to browse
+ * @param [out] stats: counters
+ * @return 0 on success, an -errno value on error
+ */
+int s_browser_get_stats(const struct s_browser *browser,
+  struct s_browser_stats *stats);
+
 /**
  * @brief Deallocate a specific group
  * @param [in] group: group to delete
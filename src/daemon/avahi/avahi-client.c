@@ -64,7 +64,7 @@ struct s_client *s_client_new(const AvahiPoll *poll, void *userdata,
   daemon_return_val_if_fail(poll, NULL);
   daemon_return_val_if_fail(funcs, NULL);
 
-  struct s_client *client = daemon_malloc(sizeof(struct s_client));
+  struct s_client *client = daemon_zalloc(sizeof(struct s_client));
   client->poll = poll;
   client->funcs = *funcs;
   client->userdata = userdata;
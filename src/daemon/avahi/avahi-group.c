@@ -0,0 +1,311 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <avahi-client/publish.h>
+#include <avahi-common/alternative.h>
+#include <avahi-common/error.h>
+#include <avahi-common/malloc.h>
+#include <inttypes.h>
+#include <libdaemon/dlog.h>
+#include "avahi-group.h"
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-hash.h"
+#include "daemon-timer.h"
+
+struct s_group {
+  struct s_client *client;
+  struct s_service_data *data;
+  uint8_t dirty;
+  uint8_t established;
+  struct s_group_funcs funcs;
+  AvahiEntryGroup *group;
+  struct s_loop *loop;
+  uint64_t published;
+  struct s_group_stats stats;
+  struct s_timer *timer;
+  struct s_hash *txt;
+  void *userdata;
+};
+
+/**
+ * @brief Append a key of the group to a txt record
+ * @param [in, out] list: txt record to extend
+ * @param [in] key: key to append
+ * @param [in] value: value of the key
+ */
+static void _s_group_txt_add(AvahiStringList **list, const char *key,
+  const char *value)
+{
+  *list = avahi_string_list_add_pair(*list, key, value);
+}
+
+/**
+ * @brief Build the txt record of a group, the service identifier followed by
+ * the runtime keys
+ * @param [in] group: group to browse
+ * @return the record, to release with #avahi_string_list_free
+ */
+static AvahiStringList *_s_group_txt_new(struct s_group *group)
+{
+  AvahiStringList *list = avahi_string_list_new(group->data->data, NULL);
+
+  s_hash_foreach(group->txt, (s_hash_foreach_cbk)_s_group_txt_add, &list);
+  return list;
+}
+
+/**
+ * @brief Add the service to the entry group and commit it, the committed
+ * record holds every runtime key
+ * @param [in] group: group to publish
+ * @return 0 on success, an -errno value on error
+ */
+static int _s_group_add(struct s_group *group);
+
+/**
+ * @brief Pick an alternative name after a collision and publish again
+ * @param [in] group: group in collision
+ */
+static void _s_group_rename(struct s_group *group)
+{
+  char *name = avahi_alternative_service_name(group->data->name);
+
+  daemon_log(LOG_NOTICE, "service '%s' collides, renamed '%s'\n",
+    group->data->name, name);
+  daemon_free(group->data->name);
+  group->data->name = strdup(name);
+  avahi_free(name);
+  group->stats.collisions++;
+
+  avahi_entry_group_reset(group->group);
+  if (_s_group_add(group) < 0)
+    group->funcs.failure(group->userdata, AVAHI_ERR_FAILURE);
+}
+
+/**
+ * @brief Schedule a txt record update, once the interval since the previous
+ * one elapsed
+ * @param [in] group: group to update
+ */
+static void _s_group_schedule(struct s_group *group)
+{
+  uint64_t now = s_loop_now(group->loop);
+  uint64_t next = group->published + GROUP_TXT_INTERVAL;
+
+  s_timer_arm(group->timer, next > now ? next - now : 0);
+}
+
+/**
+ * @brief Avahi entry group callback
+ * @param [in] avahi_group: avahi entry group
+ * @param [in] state: state of the entry group
+ * @param [in] group: group instance
+ */
+static void _s_group_cbk(AvahiEntryGroup *avahi_group,
+  AvahiEntryGroupState state, struct s_group *group)
+{
+  daemon_return_if_fail(group);
+
+  /* raised from avahi_entry_group_new as well, before it returned */
+  group->group = avahi_group;
+  group->established = state == AVAHI_ENTRY_GROUP_ESTABLISHED;
+  switch (state) {
+  case AVAHI_ENTRY_GROUP_ESTABLISHED:
+    group->funcs.established(group->userdata, group->data->name);
+    if (group->dirty)
+      _s_group_schedule(group);
+    break;
+  case AVAHI_ENTRY_GROUP_COLLISION:
+    _s_group_rename(group);
+    break;
+  case AVAHI_ENTRY_GROUP_FAILURE:
+    group->funcs.failure(group->userdata,
+      avahi_client_errno(avahi_entry_group_get_client(avahi_group)));
+    break;
+  case AVAHI_ENTRY_GROUP_UNCOMMITED:
+  case AVAHI_ENTRY_GROUP_REGISTERING:
+    break;
+  }
+}
+
+static int _s_group_add(struct s_group *group)
+{
+  struct s_service_data *data = group->data;
+
+  if (!group->group) {
+    group->group = avahi_entry_group_new(s_client_toavahi(group->client),
+      (AvahiEntryGroupCallback)_s_group_cbk, group);
+    if (!group->group) {
+      daemon_log(LOG_ERR, "failed to allocate an entry group\n");
+      return -EBADE;
+    }
+  }
+
+  AvahiStringList *list = _s_group_txt_new(group);
+  int ret = avahi_entry_group_add_service_strlst(group->group,
+    data->interface, data->protocol, 0, data->name, data->type, data->domain,
+    data->host, data->port, list);
+  avahi_string_list_free(list);
+  if (ret >= 0)
+    ret = avahi_entry_group_commit(group->group);
+  if (ret < 0) {
+    daemon_log(LOG_ERR, "failed to publish '%s': %s\n", data->name,
+      avahi_strerror(ret));
+    return -EBADE;
+  }
+
+  group->dirty = 0;
+  group->published = s_loop_now(group->loop);
+  s_timer_cancel(group->timer);
+  return 0;
+}
+
+/**
+ * @brief Timer callback, update the txt record on the network
+ * @param [in] timer: expired timer
+ * @param [in] group: group to update
+ */
+static void _s_group_update(daemon_unused struct s_timer *timer,
+  struct s_group *group)
+{
+  daemon_return_if_fail(group);
+
+  struct s_service_data *data = group->data;
+
+  if (!group->dirty || !group->established)
+    return;
+
+  AvahiStringList *list = _s_group_txt_new(group);
+  int ret = avahi_entry_group_update_service_txt_strlst(group->group,
+    data->interface, data->protocol, 0, data->name, data->type, data->domain,
+    list);
+  avahi_string_list_free(list);
+  if (ret < 0) {
+    daemon_log(LOG_ERR, "failed to update '%s': %s\n", data->name,
+      avahi_strerror(ret));
+    return;
+  }
+
+  group->dirty = 0;
+  group->published = s_loop_now(group->loop);
+  group->stats.updates++;
+}
+
+struct s_group *s_group_new(struct s_client *client, struct s_loop *loop,
+  struct s_service_data *data, const struct s_group_funcs *funcs,
+  void *userdata)
+{
+  daemon_return_val_if_fail(client, NULL);
+  daemon_return_val_if_fail(loop, NULL);
+  daemon_return_val_if_fail(data, NULL);
+  daemon_return_val_if_fail(funcs, NULL);
+
+  struct s_group *group = daemon_zalloc(sizeof(struct s_group));
+  group->client = client;
+  group->data = data;
+  group->funcs = *funcs;
+  group->loop = loop;
+  group->txt = s_hash_new((s_hash_free_cbk)daemon_free);
+  group->timer = s_timer_new(loop, (s_timer_cbk)_s_group_update, group);
+  group->userdata = userdata;
+
+  if (!group->txt || !group->timer)
+    goto error;
+
+  return group;
+
+error:
+  daemon_log(LOG_ERR, "failed to allocate a group instance\n");
+  s_group_free(group);
+  return NULL;
+}
+
+void s_group_free(struct s_group *group)
+{
+  daemon_return_if_fail(group);
+
+  daemon_log(LOG_INFO, "group: %" PRIu64 " updates, %" PRIu64 " coalesced, %"
+    PRIu64 " unchanged, %" PRIu64 " collisions\n", group->stats.updates,
+    group->stats.coalesced, group->stats.unchanged, group->stats.collisions);
+  if (group->timer)
+    s_timer_free(group->timer);
+  /* withdraws the service from the network */
+  if (group->group)
+    avahi_entry_group_free(group->group);
+  if (group->txt)
+    s_hash_free(group->txt);
+  s_service_free(group->data);
+  daemon_free(group);
+}
+
+int s_group_publish(struct s_group *group)
+{
+  daemon_return_val_if_fail(group, -EINVAL);
+
+  if (group->group && !avahi_entry_group_is_empty(group->group))
+    return -EALREADY;
+  return _s_group_add(group);
+}
+
+int s_group_reset(struct s_group *group)
+{
+  daemon_return_val_if_fail(group, -EINVAL);
+
+  group->established = 0;
+  s_timer_cancel(group->timer);
+  if (group->group)
+    avahi_entry_group_reset(group->group);
+  return 0;
+}
+
+int s_group_set_txt(struct s_group *group, const char *key,
+  const char *value)
+{
+  daemon_return_val_if_fail(group, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+  daemon_return_val_if_fail(value, -EINVAL);
+
+  const char *current = s_hash_lookup(group->txt, key);
+  if (current) {
+    if (strcmp(current, value) == 0) {
+      group->stats.unchanged++;
+      return 0;
+    }
+    s_hash_remove(group->txt, key);
+  }
+
+  int ret = s_hash_insert(group->txt, key, strdup(value));
+  if (ret < 0)
+    return ret;
+
+  if (group->dirty)
+    group->stats.coalesced++;
+  group->dirty = 1;
+  if (group->established && !s_timer_is_armed(group->timer))
+    _s_group_schedule(group);
+  return 0;
+}
+
+int s_group_get_stats(const struct s_group *group,
+  struct s_group_stats *stats)
+{
+  daemon_return_val_if_fail(group, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
+
+  *stats = group->stats;
+  return 0;
+}
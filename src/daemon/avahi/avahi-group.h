@@ -0,0 +1,124 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AVAHI_AVAHI_GROUP_H_
+# define _AVAHI_AVAHI_GROUP_H_
+
+# include <stdint.h>
+# include "avahi-client.h"
+# include "avahi-service.h"
+# include "daemon-loop.h"
+
+/**
+ * @brief Published service. The txt record holds the service identifier and
+ * a set of keys updated at runtime, at most once per #GROUP_TXT_INTERVAL
+ */
+struct s_group;
+
+/**
+ * @brief Minimum delay in milliseconds between two txt record updates, to
+ * avoid flooding the network with announcements
+ */
+# define GROUP_TXT_INTERVAL 10000
+
+/**
+ * @brief Group counters. @coalesced counts the changes merged in a pending
+ * update, @unchanged the changes ignored since the value did not change
+ */
+struct s_group_stats {
+  uint64_t coalesced;
+  uint64_t collisions;
+  uint64_t unchanged;
+  uint64_t updates;
+};
+
+/**
+ * @brief Call when the service is registered on the network
+ * @param [in] userdata: userdata passing through the allocation
+ * @param [in] name: name of the service, changed on a collision
+ */
+typedef void (*s_group_established_cbk)(void *userdata, const char *name);
+
+/**
+ * @brief Call when an error occured.
+ * @param [in] userdata: userdata passing through the allocation
+ * @param [in] error: the avahi error value
+ */
+typedef void (*s_group_failure_cbk)(void *userdata, int error);
+
+struct s_group_funcs {
+  s_group_established_cbk established;
+  s_group_failure_cbk failure;
+};
+
+/**
+ * @brief Allocate a new group, its service is published by #s_group_publish
+ * @param [in] client: running client structure
+ * @param [in] loop: loop of the client, running the deferred updates
+ * @param [in] data: service description, owned by the group
+ * @param [in] funcs: functions behavior description
+ * @param [in] userdata: user pointer
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_group *s_group_new(struct s_client *client, struct s_loop *loop,
+  struct s_service_data *data, const struct s_group_funcs *funcs,
+  void *userdata);
+
+/**
+ * @brief Deallocate a specific group, withdrawing its service
+ * @param [in] group: group to delete
+ */
+void s_group_free(struct s_group *group);
+
+/**
+ * @brief Publish the service, first or again after a reset. The record holds
+ * the keys set so far
+ * @param [in] group: group to publish
+ * @return 0 on success, -EALREADY if already published, an -errno value on
+ * error
+ */
+int s_group_publish(struct s_group *group);
+
+/**
+ * @brief Withdraw the service, when the host name of the client collides
+ * @param [in] group: group to reset
+ * @return 0 on success, an -errno value on error
+ */
+int s_group_reset(struct s_group *group);
+
+/**
+ * @brief Set a key of the txt record. The record is updated on the network
+ * once the interval since the previous update elapsed, the changes made in
+ * between are merged
+ * @param [in] group: group to modify
+ * @param [in] key: key to set
+ * @param [in] value: value of the key
+ * @return 0 on success, an -errno value on error
+ */
+int s_group_set_txt(struct s_group *group, const char *key,
+  const char *value);
+
+/**
+ * @brief Get the counters of a group
+ * @param [in] group: group to browse
+ * @param [out] stats: counters
+ * @return 0 on success, an -errno value on error
+ */
+int s_group_get_stats(const struct s_group *group,
+  struct s_group_stats *stats);
+
+#endif /* !_AVAHI_AVAHI_GROUP_H_ */
@@ -23,21 +23,24 @@
 #include "daemon-cond.h"
 
 /**
- * @brief Key token used to identified cerebellum service description from the
+ * @brief Token used to identified cerebellum service description from the
  * rest
  */
-const char *_g_service_key = "id=d6c4e9bcccdb8b16083036b45048dd52";
+const char *_g_service_id = "d6c4e9bcccdb8b16083036b45048dd52";
 
 struct s_service_data *s_service_generate(void)
 {
   struct s_service_data *data = daemon_malloc(sizeof(struct s_service_data));
-  data->data = strdup(_g_service_key);
+  size_t size = strlen(SERVICE_ID) + strlen(_g_service_id) + 2;
+  data->data = daemon_malloc(size);
+  snprintf(data->data, size, "%s=%s", SERVICE_ID, _g_service_id);
   data->domain = NULL;
   data->host = NULL;
   data->interface = AVAHI_IF_UNSPEC;
   data->name = strdup("cerebellum");
-  data->port = 651;
-  data->protocol = AVAHI_PROTO_INET;
+  data->port = SERVICE_PORT;
+  /* browsed and published over IPv4 and IPv6 */
+  data->protocol = AVAHI_PROTO_UNSPEC;
   data->type = strdup("_http._tcp");
   return data;
 }
@@ -59,12 +62,9 @@ void s_service_free(struct s_service_data *data)
   daemon_free(data);
 }
 
-int s_service_check(const char *key)
+int s_service_check(const char *id)
 {
-  daemon_return_val_if_fail(key, -EINVAL);
+  daemon_return_val_if_fail(id, -EINVAL);
 
-  uint8_t size = strlen(key);
-  uint8_t key_size = strlen(_g_service_key);
-
-  return (size != key_size) ? 1 : strncmp(key, _g_service_key, size);
+  return strcmp(id, _g_service_id) != 0;
 }
@@ -20,6 +20,24 @@
 
 # include <stdint.h>
 
+/**
+ * @brief Port advertised by the service, the daemon accepts its peers on it
+ */
+# define SERVICE_PORT 651
+
+/**
+ * @brief Txt record key identifying the cerebellum services
+ */
+# define SERVICE_ID "id"
+
+/**
+ * @brief Txt record keys of the load published by a service: its number of
+ * peers, its number of queued jobs and its cpu usage in percent
+ */
+# define SERVICE_LOAD_CONNECTIONS "conns"
+# define SERVICE_LOAD_CPU "cpu"
+# define SERVICE_LOAD_QUEUE "queue"
+
 struct s_service_data {
   char *data;
   char *domain;
@@ -44,10 +62,10 @@ struct s_service_data *s_service_generate(void);
 void s_service_free(struct s_service_data *data);
 
 /**
- * @brief Check the txt record of a service
- * @param [in] key: key to check
- * @return 0 if the key match, other value otherwise
+ * @brief Check the identifier published in the txt record of a service
+ * @param [in] id: value of the #SERVICE_ID key
+ * @return 0 if the identifier match, other value otherwise
  */
-int s_service_check(const char *key);
+int s_service_check(const char *id);
 
 #endif /* !_AVAHI_AVAHI_SERVICE_H_ */
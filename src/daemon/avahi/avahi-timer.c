@@ -20,19 +20,35 @@
 #include "daemon-alloc.h"
 #include "daemon-cond.h"
 #include "daemon-loop.h"
+#include "daemon-timer.h"
 
 struct s_avahi_timer {
   AvahiTimeoutCallback callback;
-  struct event *event;
+  struct s_loop *loop;
+  struct s_timer *timer;
   void *userdata;
 };
 
-static void _s_avahi_timeout_cbk(daemon_unused evutil_socket_t fd,
-  daemon_unused short e, struct s_avahi_timer *timer)
+static void _s_avahi_timeout_cbk(daemon_unused struct s_timer *timer,
+  struct s_avahi_timer *avahi)
 {
-  daemon_return_if_fail(timer);
+  daemon_return_if_fail(avahi);
+
+  avahi->callback((AvahiTimeout *)avahi, avahi->userdata);
+}
 
-  timer->callback((AvahiTimeout *)timer, timer->userdata);
+/**
+ * @brief Arm a timer on an avahi absolute deadline
+ * @param [in] avahi: timer to arm
+ * @param [in] tv: absolute deadline, NULL to disarm
+ */
+static void _s_avahi_timer_arm(struct s_avahi_timer *avahi,
+  const struct timeval *tv)
+{
+  if (tv)
+    s_timer_arm(avahi->timer, s_loop_delay_until(avahi->loop, tv));
+  else
+    s_timer_cancel(avahi->timer);
 }
 
 struct s_avahi_timer *s_avahi_timer_new(const AvahiPoll *api,
@@ -43,27 +59,20 @@ struct s_avahi_timer *s_avahi_timer_new(const AvahiPoll *api,
 
   struct s_loop *loop = api->userdata;
 
-  struct s_avahi_timer *timer = daemon_malloc(sizeof(struct s_avahi_timer));
-  timer->callback = callback;
-  timer->userdata = userdata;
-
-  struct timeval now, e_tv;
-  timer->event = event_new(s_loop_tolibevent(loop), -1, EV_TIMEOUT,
-    (event_callback_fn)_s_avahi_timeout_cbk, timer);
-  if (!tv || ((tv->tv_sec == 0) && (tv->tv_usec == 0)))
-    evutil_timerclear(&e_tv);
-  else {
-    (void)gettimeofday(&now, NULL);
-    evutil_timersub(tv, &now, &e_tv);
-  }
-  if (!timer->event || evtimer_add(timer->event, &e_tv) < 0)
+  struct s_avahi_timer *avahi = daemon_malloc(sizeof(struct s_avahi_timer));
+  avahi->callback = callback;
+  avahi->loop = loop;
+  avahi->userdata = userdata;
+  avahi->timer = s_timer_new(loop, (s_timer_cbk)_s_avahi_timeout_cbk, avahi);
+  if (!avahi->timer)
     goto error;
 
-  return timer;
+  _s_avahi_timer_arm(avahi, tv);
+  return avahi;
 
 error:
   daemon_log(LOG_ERR, "failed to allocate a timer\n");
-  s_avahi_timer_free(timer);
+  s_avahi_timer_free(avahi);
   return NULL;
 }
 
@@ -72,24 +81,14 @@ void s_avahi_timer_update(struct s_avahi_timer *timer,
 {
   daemon_return_if_fail(timer);
 
-  struct timeval now, e_tv;
-
-  event_del(timer->event);
-
-  if (!tv)
-    return;
-
-  (void)gettimeofday(&now, NULL);
-  evutil_timersub(tv, &now, &e_tv);
-
-  event_add(timer->event, &e_tv);
+  _s_avahi_timer_arm(timer, tv);
 }
 
 void s_avahi_timer_free(struct s_avahi_timer *timer)
 {
   daemon_return_if_fail(timer);
 
-  event_del(timer->event);
-  event_free(timer->event);
+  if (timer->timer)
+    s_timer_free(timer->timer);
   daemon_free(timer);
 }
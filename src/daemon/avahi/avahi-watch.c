@@ -15,6 +15,7 @@
  * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <inttypes.h>
 #include <libdaemon/dlog.h>
 #include "avahi-watch.h"
 #include "daemon-alloc.h"
@@ -25,12 +26,15 @@ struct s_avahi_watch {
   struct event_base *base;
   AvahiWatchCallback callback;
   struct event *event;
+  AvahiWatchEvent events;
   int fd;
+  AvahiWatchEvent happened;
+  struct s_avahi_watch_stats stats;
   void *userdata;
 };
 
 static void _s_avahi_watch_cbk(daemon_unused evutil_socket_t fd,
-  daemon_unused short what, struct s_avahi_watch *watch)
+  short what, struct s_avahi_watch *watch)
 {
   daemon_return_if_fail(watch);
 
@@ -40,31 +44,50 @@ static void _s_avahi_watch_cbk(daemon_unused evutil_socket_t fd,
   if (what & EV_WRITE)
     events |= AVAHI_WATCH_OUT;
 
+  watch->happened = events;
   watch->callback((AvahiWatch *)watch, fd, events, watch->userdata);
 }
 
-struct s_avahi_watch *s_avahi_watch_new(const AvahiPoll *api, int fd,
-  AvahiWatchEvent events, AvahiWatchCallback callback, void *data)
+/**
+ * @brief Register the interest of a watch on its event, the event must not be
+ * pending. Nothing is registered without interest
+ * @param [in] watch: watch to register
+ * @param [in] events: avahi interest
+ * @return 0 on success, an -errno value on error
+ */
+static int _s_avahi_watch_assign(struct s_avahi_watch *watch,
+  AvahiWatchEvent events)
 {
-  daemon_return_val_if_fail(api, NULL);
-  daemon_return_val_if_fail(callback, NULL);
-
-  struct s_avahi_watch *watch = daemon_malloc(sizeof(struct s_avahi_watch));
-  watch->base = s_loop_tolibevent(api->userdata);
-
   short ev_events = EV_PERSIST;
   if (events & AVAHI_WATCH_IN)
     ev_events |= EV_READ;
   if (events & AVAHI_WATCH_OUT)
     ev_events |= EV_WRITE;
 
+  watch->events = events;
+  if (event_assign(watch->event, watch->base, watch->fd, ev_events,
+      (event_callback_fn)_s_avahi_watch_cbk, watch) < 0)
+    return -EINVAL;
+  if (!(ev_events & (EV_READ | EV_WRITE)))
+    return 0;
+  return event_add(watch->event, NULL) < 0 ? -EBADE : 0;
+}
+
+struct s_avahi_watch *s_avahi_watch_new(const AvahiPoll *api, int fd,
+  AvahiWatchEvent events, AvahiWatchCallback callback, void *data)
+{
+  daemon_return_val_if_fail(api, NULL);
+  daemon_return_val_if_fail(callback, NULL);
+
+  struct s_avahi_watch *watch = daemon_zalloc(sizeof(struct s_avahi_watch));
+  watch->base = s_loop_tolibevent(api->userdata);
   watch->callback = callback;
-  watch->event = event_new(watch->base, fd, ev_events,
-    (event_callback_fn)_s_avahi_watch_cbk, watch);
+  /* allocated once, assigned again on every interest change */
+  watch->event = event_new(watch->base, -1, 0, NULL, NULL);
   watch->fd = fd;
   watch->userdata = data;
 
-  if (!watch->event || event_add(watch->event, NULL) != 0)
+  if (!watch->event || _s_avahi_watch_assign(watch, events) < 0)
     goto error;
 
   return watch;
@@ -79,19 +102,14 @@ void s_avahi_watch_update(struct s_avahi_watch *watch, AvahiWatchEvent events)
 {
   daemon_return_if_fail(watch);
 
-  event_del(watch->event);
-  event_free(watch->event);
-
-  short ev_events = EV_PERSIST;
-  if (events & AVAHI_WATCH_IN)
-    ev_events |= EV_READ;
-  if (events & AVAHI_WATCH_OUT)
-    ev_events |= EV_WRITE;
-
-  watch->event = event_new(watch->base, watch->fd, ev_events,
-    (event_callback_fn)_s_avahi_watch_cbk, watch);
+  watch->stats.updates++;
+  if (events == watch->events) {
+    watch->stats.unchanged++;
+    return;
+  }
 
-  if (!watch->event || event_add(watch->event, NULL))
+  event_del(watch->event);
+  if (_s_avahi_watch_assign(watch, events) < 0)
     daemon_log(LOG_ERR, "failed to update an event");
 }
 
@@ -99,20 +117,28 @@ AvahiWatchEvent s_avahi_watch_get_events(struct s_avahi_watch *watch)
 {
   daemon_return_val_if_fail(watch, 0);
 
-  AvahiWatchEvent events = 0;
-  if (event_pending(watch->event, EV_READ, NULL))
-    events |= AVAHI_WATCH_IN;
-  if (event_pending(watch->event, EV_WRITE, NULL))
-    events |= AVAHI_WATCH_OUT;
+  return watch->happened;
+}
+
+int s_avahi_watch_get_stats(const struct s_avahi_watch *watch,
+  struct s_avahi_watch_stats *stats)
+{
+  daemon_return_val_if_fail(watch, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
 
-  return events;
+  *stats = watch->stats;
+  return 0;
 }
 
 void s_avahi_watch_free(struct s_avahi_watch *watch)
 {
   daemon_return_if_fail(watch);
 
-  event_del(watch->event);
-  event_free(watch->event);
+  daemon_log(LOG_INFO, "avahi watch on fd %d: %" PRIu64 " updates, %" PRIu64
+    " unchanged\n", watch->fd, watch->stats.updates, watch->stats.unchanged);
+  if (watch->event) {
+    event_del(watch->event);
+    event_free(watch->event);
+  }
   daemon_free(watch);
 }
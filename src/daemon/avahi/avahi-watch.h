@@ -19,9 +19,19 @@
 # define _AVAHI_AVAHI_WATCH_H_
 
 # include <avahi-common/watch.h>
+# include <stdint.h>
 
 struct s_avahi_watch;
 
+/**
+ * @brief Counters of a watch point. @updates counts the interest changes
+ * requested by avahi, @unchanged the ones left without any libevent call
+ */
+struct s_avahi_watch_stats {
+  uint64_t unchanged;
+  uint64_t updates;
+};
+
 /**
  * @brief Create a new watch for the specified file descriptor and for the
  * specified events. The API will call the callback function whenever any of
@@ -70,12 +80,21 @@ struct s_avahi_watch *s_avahi_watch_new(const AvahiPoll *api, int fd,
 void s_avahi_watch_update(struct s_avahi_watch *watch, AvahiWatchEvent evt);
 
 /**
- * @brief Get the event description of a watch point
+ * @brief Get the events raised by the last callback of a watch point
  * @param [in] watch: watch to browse
  * @return the event description on success, 0 on error
  */
 AvahiWatchEvent s_avahi_watch_get_events(struct s_avahi_watch *watch);
 
+/**
+ * @brief Get the counters of a watch point
+ * @param [in] watch: watch to browse
+ * @param [out] stats: counters to fill
+ * @return 0 on success, an -errno value on error
+ */
+int s_avahi_watch_get_stats(const struct s_avahi_watch *watch,
+  struct s_avahi_watch_stats *stats);
+
 /**
  * @brief Deallocate a specific watch point
  * @param [in] watch: watch to delete
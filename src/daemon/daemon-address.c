@@ -0,0 +1,115 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+#include "daemon-address.h"
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+
+socklen_t s_address_get_size(const struct sockaddr_storage *address)
+{
+  daemon_return_val_if_fail(address, 0);
+
+  switch (address->ss_family) {
+  case AF_INET:
+    return sizeof(struct sockaddr_in);
+  case AF_INET6:
+    return sizeof(struct sockaddr_in6);
+  }
+  return 0;
+}
+
+int s_address_to_string(const struct sockaddr_storage *address, char *str,
+  size_t size)
+{
+  daemon_return_val_if_fail(address, -EINVAL);
+  daemon_return_val_if_fail(str, -EINVAL);
+
+  const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)address;
+  const struct sockaddr_in *sin = (const struct sockaddr_in *)address;
+  char host[INET6_ADDRSTRLEN];
+
+  switch (address->ss_family) {
+  case AF_INET:
+    if (!inet_ntop(AF_INET, &sin->sin_addr, host, sizeof(host)))
+      return -errno;
+    snprintf(str, size, "%s:%u", host, ntohs(sin->sin_port));
+    return 0;
+  case AF_INET6:
+    if (!inet_ntop(AF_INET6, &sin6->sin6_addr, host, sizeof(host)))
+      return -errno;
+    snprintf(str, size, "[%s]:%u", host, ntohs(sin6->sin6_port));
+    return 0;
+  }
+  return -EAFNOSUPPORT;
+}
+
+int s_address_parse(const char *host, uint16_t port, uint32_t scope,
+  struct sockaddr_storage *address)
+{
+  daemon_return_val_if_fail(host, -EINVAL);
+  daemon_return_val_if_fail(address, -EINVAL);
+
+  struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)address;
+  struct sockaddr_in *sin = (struct sockaddr_in *)address;
+
+  memset(address, 0, sizeof(*address));
+  if (inet_pton(AF_INET, host, &sin->sin_addr) == 1) {
+    sin->sin_family = AF_INET;
+    sin->sin_port = htons(port);
+    return 0;
+  }
+  if (inet_pton(AF_INET6, host, &sin6->sin6_addr) == 1) {
+    sin6->sin6_family = AF_INET6;
+    sin6->sin6_port = htons(port);
+    /* a link local address is only reachable through its interface */
+    if (IN6_IS_ADDR_LINKLOCAL(&sin6->sin6_addr))
+      sin6->sin6_scope_id = scope;
+    return 0;
+  }
+  return -EINVAL;
+}
+
+void s_address_interleave(struct sockaddr_storage *addresses, uint32_t count)
+{
+  daemon_return_if_fail(addresses);
+
+  if (count < 2)
+    return;
+
+  struct sockaddr_storage *sorted = daemon_malloc(count * sizeof(*sorted));
+  uint32_t ipv6 = 0;
+  uint32_t other = 0;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    /* the next address of the family expected at this position */
+    sa_family_t family = (i % 2 == 0) ? AF_INET6 : AF_INET;
+
+    while (ipv6 < count && addresses[ipv6].ss_family != AF_INET6)
+      ++ipv6;
+    while (other < count && addresses[other].ss_family == AF_INET6)
+      ++other;
+    if ((family == AF_INET6 && ipv6 < count) || other >= count)
+      sorted[i] = addresses[ipv6++];
+    else
+      sorted[i] = addresses[other++];
+  }
+  memcpy(addresses, sorted, count * sizeof(*sorted));
+  daemon_free(sorted);
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DAEMON_ADDRESS_H_
+# define _DAEMON_ADDRESS_H_
+
+# include <netinet/in.h>
+# include <stdint.h>
+# include <sys/socket.h>
+
+/**
+ * @brief Size of an address formatted by #s_address_to_string, brackets and
+ * port included
+ */
+# define ADDRESS_STR_MAX (INET6_ADDRSTRLEN + 8)
+
+/**
+ * @brief Get the size of the socket address of a family
+ * @param [in] address: IPv4 or IPv6 address
+ * @return the size, 0 for another family
+ */
+socklen_t s_address_get_size(const struct sockaddr_storage *address);
+
+/**
+ * @brief Format an address and its port, as host:port for IPv4 and
+ * [host]:port for IPv6
+ * @param [in] address: IPv4 or IPv6 address
+ * @param [out] str: formatted address
+ * @param [in] size: size of @str, #ADDRESS_STR_MAX at least
+ * @return 0 on success, an -errno value on error
+ */
+int s_address_to_string(const struct sockaddr_storage *address, char *str,
+  size_t size);
+
+/**
+ * @brief Parse a numeric IPv4 or IPv6 address
+ * @param [in] host: address to parse
+ * @param [in] port: port of the address
+ * @param [in] scope: interface index of an IPv6 link local address
+ * @param [out] address: parsed address
+ * @return 0 on success, an -errno value on error
+ */
+int s_address_parse(const char *host, uint16_t port, uint32_t scope,
+  struct sockaddr_storage *address);
+
+/**
+ * @brief Order a list of addresses for a connection race: the families
+ * alternate, IPv6 first, the order within a family is kept (RFC 8305)
+ * @param [in, out] addresses: addresses to order
+ * @param [in] count: number of addresses
+ */
+void s_address_interleave(struct sockaddr_storage *addresses, uint32_t count);
+
+#endif /* !_DAEMON_ADDRESS_H_ */
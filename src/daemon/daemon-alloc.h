@@ -18,12 +18,14 @@
 #ifndef _DAEMON_ALLOC_H_
 # define _DAEMON_ALLOC_H_
 
+# include <stdint.h>
 # include <stdlib.h>
 # include "daemon-cond.h"
+# include "daemon-pool.h"
 
 /**
  * @brief Same behavior than the standard #calloc + control memory and assert if
- * no memory available + memset to 0
+ * no memory available. The memory is already zeroed by #calloc
  * @param [in] nmemb : nmemb elements
  * @param [in] size : size bytes for each element
  * @return a valid pointer on success, NULL on error
@@ -33,7 +35,6 @@ static inline void *daemon_calloc(size_t nmemb, size_t size)
   void *ptr = calloc(nmemb, size);
   daemon_assert(ptr, "allocator failed '%s'\n", strerror(errno));
 
-  memset(ptr, 0, size * nmemb);
   return ptr;
 }
 
@@ -49,7 +50,8 @@ static inline void daemon_free(void *ptr)
 
 /**
  * @brief Same behavior than the standard #malloc + control memory and assert if
- * no memory available + memset to 0
+ * no memory available. The memory is not initialized, use it when the caller
+ * fills the whole block
  * @param [in] size : size bytes to allocate
  * @return a valid pointer on success, NULL on error
  */
@@ -58,23 +60,49 @@ static inline void *daemon_malloc(size_t size)
   void *ptr = malloc(size);
   daemon_assert(ptr, "allocator failed '%s'\n", strerror(errno));
 
-  memset(ptr, 0, size);
   return ptr;
 }
 
+/**
+ * @brief Same behavior than #daemon_malloc + memset to 0
+ * @param [in] size : size bytes to allocate
+ * @return a valid pointer on success, NULL on error
+ */
+static inline void *daemon_zalloc(size_t size)
+{
+  return daemon_calloc(1, size);
+}
+
 /**
  * @brief Same behavior than the standard #realloc + control memory and assert
- * if no memory available + memset to 0
- * @param [in] ptr : initial pointer to modify
+ * if no memory available. The content is preserved up to the smallest size,
+ * the grown part is not initialized
+ * @param [in] ptr : initial pointer to modify, can be NULL
  * @param [in] size : size bytes to allocate
  * @return a valid pointer on success, NULL on error
  */
 static inline void *daemon_realloc(void *ptr, size_t size)
 {
   void *_ptr = realloc(ptr, size);
-  daemon_assert(ptr, "allocator failed '%s'\n", strerror(errno));
+  daemon_assert(_ptr, "allocator failed '%s'\n", strerror(errno));
+
+  return _ptr;
+}
+
+/**
+ * @brief Same behavior than #daemon_realloc + memset to 0 of the grown part
+ * only, the preserved content is not touched
+ * @param [in] ptr : initial pointer to modify, can be NULL
+ * @param [in] old_size : size bytes of the initial allocation
+ * @param [in] size : size bytes to allocate
+ * @return a valid pointer on success, NULL on error
+ */
+static inline void *daemon_zrealloc(void *ptr, size_t old_size, size_t size)
+{
+  uint8_t *_ptr = daemon_realloc(ptr, size);
 
-  memset(_ptr, 0, size);
+  if (size > old_size)
+    memset(_ptr + old_size, 0, size - old_size);
   return _ptr;
 }
 
@@ -0,0 +1,324 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <libdaemon/dlog.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "daemon-alloc.h"
+#include "daemon-balancer.h"
+#include "daemon-cond.h"
+#include "ssl/ssl-client.h"
+
+/**
+ * @brief Load ratio between a connected peer and a candidate above which the
+ * candidate replaces the peer, so that close loads do not flap
+ */
+#define BALANCER_EVICT_RATIO 2
+
+struct s_balancer_name {
+  const char *name;
+  enum e_balancer_policy policy;
+};
+
+static const struct s_balancer_name _g_balancer_names[] = {
+  { "least-outstanding", e_balancer_policy_least_outstanding },
+  { "round-robin", e_balancer_policy_round_robin },
+  { "two-choices", e_balancer_policy_two_choices },
+};
+
+struct s_balancer {
+  uint32_t next;
+  struct s_peers *peers;
+  enum e_balancer_policy policy;
+  uint32_t seed;
+  struct s_balancer_stats stats;
+};
+
+/**
+ * @brief State of a selection, built over an iteration of the peers. @wrap
+ * is the position of @first
+ */
+struct s_balancer_pick {
+  struct s_balancer *balancer;
+  uint32_t eligible;
+  struct s_peer *first;
+  uint32_t index;
+  struct s_peer *picked[2];
+  uint64_t cost;
+  uint32_t wrap;
+};
+
+/**
+ * @brief Get a pseudo random number, xorshift
+ * @param [in] balancer: balancer owning the generator
+ * @return a random number
+ */
+static uint32_t _s_balancer_random(struct s_balancer *balancer)
+{
+  uint32_t x = balancer->seed;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  balancer->seed = x;
+  return x;
+}
+
+/**
+ * @brief Get the advertised load of a peer as a single figure
+ * @param [in] load: advertised load
+ * @return the load, the higher the busier
+ */
+static uint64_t _s_balancer_load(const struct s_peer_load *load)
+{
+  return (uint64_t)(100 + load->cpu) * (1 + load->queue);
+}
+
+/**
+ * @brief Get the cost of a peer: its round trip time weighted by its
+ * advertised load and by the bytes waiting to be sent to it, in KiB
+ * @param [in] peer: peer to evaluate
+ * @return the cost, the higher the slower
+ */
+static uint64_t _s_balancer_cost(struct s_peer *peer)
+{
+  size_t pending = s_ssl_client_get_pending(peer->client);
+
+  return (uint64_t)(peer->rtt + 1) * (100 + peer->load.cpu) *
+    (1 + peer->load.queue + (pending >> 10));
+}
+
+/**
+ * @brief Check if a message can be routed to a peer
+ * @param [in] peer: peer to check
+ * @return 1 if the peer is connected and writable, 0 otherwise
+ */
+static uint8_t _s_balancer_eligible(const struct s_peer *peer)
+{
+  /* checked first, the inbound peers belong to other threads */
+  if (peer->inbound)
+    return 0;
+  return peer->state == e_peer_state_connected && peer->client &&
+    s_ssl_client_is_congested(peer->client) == 0;
+}
+
+/**
+ * @brief Round robin iteration, the first eligible peer from the position
+ * following the previous pick, wrapping around
+ * @param [in, out] pick: selection state
+ * @param [in] peer: peer of the iteration
+ */
+static void _s_balancer_round_robin(struct s_balancer_pick *pick,
+  struct s_peer *peer)
+{
+  uint32_t index = pick->index++;
+
+  if (!_s_balancer_eligible(peer))
+    return;
+  if (!pick->first) {
+    pick->first = peer;
+    pick->wrap = index;
+  }
+  if (!pick->picked[0] && index >= pick->balancer->next) {
+    pick->picked[0] = peer;
+    pick->balancer->next = index + 1;
+  }
+}
+
+/**
+ * @brief Least outstanding iteration, the peer with the fewest bytes waiting
+ * to be sent
+ * @param [in, out] pick: selection state
+ * @param [in] peer: peer of the iteration
+ */
+static void _s_balancer_least_outstanding(struct s_balancer_pick *pick,
+  struct s_peer *peer)
+{
+  if (!_s_balancer_eligible(peer))
+    return;
+
+  uint64_t pending = s_ssl_client_get_pending(peer->client);
+  if (!pick->picked[0] || pending < pick->cost) {
+    pick->picked[0] = peer;
+    pick->cost = pending;
+  }
+}
+
+/**
+ * @brief Two choices iteration, draw two distinct eligible peers with a
+ * reservoir sampling so the peers are browsed once
+ * @param [in, out] pick: selection state
+ * @param [in] peer: peer of the iteration
+ */
+static void _s_balancer_two_choices(struct s_balancer_pick *pick,
+  struct s_peer *peer)
+{
+  if (!_s_balancer_eligible(peer))
+    return;
+
+  uint32_t index = pick->eligible++;
+  if (index < 2) {
+    pick->picked[index] = peer;
+    return;
+  }
+
+  uint32_t slot = _s_balancer_random(pick->balancer) % (index + 1);
+  if (slot < 2)
+    pick->picked[slot] = peer;
+}
+
+/**
+ * @brief Eviction iteration, the connected outbound peer with the highest
+ * advertised load
+ * @param [in, out] pick: selection state
+ * @param [in] peer: peer of the iteration
+ */
+static void _s_balancer_worst(struct s_balancer_pick *pick,
+  struct s_peer *peer)
+{
+  if (peer->inbound || peer->state == e_peer_state_closed)
+    return;
+
+  uint64_t load = _s_balancer_load(&peer->load);
+  if (!pick->picked[0] || load > pick->cost) {
+    pick->picked[0] = peer;
+    pick->cost = load;
+  }
+}
+
+struct s_balancer *s_balancer_new(struct s_peers *peers,
+  enum e_balancer_policy policy)
+{
+  daemon_return_val_if_fail(peers, NULL);
+
+  struct s_balancer *balancer = daemon_zalloc(sizeof(struct s_balancer));
+  balancer->peers = peers;
+  balancer->policy = policy;
+  /* xorshift needs a non zero state */
+  balancer->seed = ((uint32_t)time(NULL) ^ (uint32_t)getpid()) | 1;
+  return balancer;
+}
+
+void s_balancer_free(struct s_balancer *balancer)
+{
+  daemon_return_if_fail(balancer);
+
+  daemon_log(LOG_INFO, "balancer: %" PRIu64 " picks, %" PRIu64
+    " unavailable, %" PRIu64 " evictions\n", balancer->stats.picks,
+    balancer->stats.unavailable, balancer->stats.evictions);
+  daemon_free(balancer);
+}
+
+int s_balancer_parse(const char *name, enum e_balancer_policy *policy)
+{
+  daemon_return_val_if_fail(name, -EINVAL);
+  daemon_return_val_if_fail(policy, -EINVAL);
+
+  for (uint32_t i = 0; i < sizeof(_g_balancer_names) /
+      sizeof(_g_balancer_names[0]); ++i) {
+    if (strcmp(name, _g_balancer_names[i].name) == 0) {
+      *policy = _g_balancer_names[i].policy;
+      return 0;
+    }
+  }
+  daemon_log(LOG_ERR, "unknown balancer policy '%s'\n", name);
+  return -ENOTSUP;
+}
+
+const char *s_balancer_get_name(const struct s_balancer *balancer)
+{
+  daemon_return_val_if_fail(balancer, NULL);
+
+  for (uint32_t i = 0; i < sizeof(_g_balancer_names) /
+      sizeof(_g_balancer_names[0]); ++i) {
+    if (_g_balancer_names[i].policy == balancer->policy)
+      return _g_balancer_names[i].name;
+  }
+  return NULL;
+}
+
+struct s_peer *s_balancer_pick(struct s_balancer *balancer)
+{
+  daemon_return_val_if_fail(balancer, NULL);
+
+  struct s_balancer_pick pick = { .balancer = balancer };
+  struct s_peer *peer = NULL;
+
+  switch (balancer->policy) {
+  case e_balancer_policy_least_outstanding:
+    s_peers_foreach(balancer->peers,
+      (s_peers_foreach_cbk)_s_balancer_least_outstanding, &pick);
+    peer = pick.picked[0];
+    break;
+  case e_balancer_policy_round_robin:
+    s_peers_foreach(balancer->peers,
+      (s_peers_foreach_cbk)_s_balancer_round_robin, &pick);
+    peer = pick.picked[0];
+    if (!peer && pick.first) {
+      peer = pick.first;
+      balancer->next = pick.wrap + 1;
+    }
+    break;
+  case e_balancer_policy_two_choices:
+    s_peers_foreach(balancer->peers,
+      (s_peers_foreach_cbk)_s_balancer_two_choices, &pick);
+    peer = pick.picked[0];
+    if (pick.picked[1] &&
+        _s_balancer_cost(pick.picked[1]) < _s_balancer_cost(peer))
+      peer = pick.picked[1];
+    break;
+  }
+
+  if (peer)
+    balancer->stats.picks++;
+  else
+    balancer->stats.unavailable++;
+  return peer;
+}
+
+struct s_peer *s_balancer_get_worst(struct s_balancer *balancer,
+  const struct s_peer_load *load)
+{
+  daemon_return_val_if_fail(balancer, NULL);
+  daemon_return_val_if_fail(load, NULL);
+
+  struct s_balancer_pick pick = { .balancer = balancer };
+
+  if (balancer->policy == e_balancer_policy_round_robin)
+    return NULL;
+
+  s_peers_foreach(balancer->peers, (s_peers_foreach_cbk)_s_balancer_worst,
+    &pick);
+  if (!pick.picked[0] ||
+      pick.cost < BALANCER_EVICT_RATIO * _s_balancer_load(load))
+    return NULL;
+
+  balancer->stats.evictions++;
+  return pick.picked[0];
+}
+
+int s_balancer_get_stats(const struct s_balancer *balancer,
+  struct s_balancer_stats *stats)
+{
+  daemon_return_val_if_fail(balancer, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
+
+  *stats = balancer->stats;
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DAEMON_BALANCER_H_
+# define _DAEMON_BALANCER_H_
+
+# include <stdint.h>
+# include "daemon-peers.h"
+
+/**
+ * @brief Peer selection policies. The cost of a peer weights its round trip
+ * time by its advertised cpu usage and by the work queued on both ends
+ */
+enum e_balancer_policy {
+  /* the peer with the fewest bytes waiting to be sent */
+  e_balancer_policy_least_outstanding,
+  /* every peer in turn */
+  e_balancer_policy_round_robin,
+  /* the cheapest of two peers drawn at random */
+  e_balancer_policy_two_choices
+};
+
+/**
+ * @brief Counters of a balancer. @unavailable counts the picks without any
+ * writable peer
+ */
+struct s_balancer_stats {
+  uint64_t evictions;
+  uint64_t picks;
+  uint64_t unavailable;
+};
+
+/**
+ * @brief Peer selector over the outbound peers of a connection manager, to
+ * use on the loop of the manager
+ */
+struct s_balancer;
+
+/**
+ * @brief Allocate a new balancer
+ * @param [in] peers: connection manager to select from
+ * @param [in] policy: selection policy
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_balancer *s_balancer_new(struct s_peers *peers,
+  enum e_balancer_policy policy);
+
+/**
+ * @brief Deallocate a specific balancer
+ * @param [in] balancer: balancer to delete
+ */
+void s_balancer_free(struct s_balancer *balancer);
+
+/**
+ * @brief Get a policy from its name
+ * @param [in] name: round-robin, least-outstanding or two-choices
+ * @param [out] policy: policy matching the name
+ * @return 0 on success, -ENOTSUP if unknown, an -errno value on error
+ */
+int s_balancer_parse(const char *name, enum e_balancer_policy *policy);
+
+/**
+ * @brief Get the name of the policy of a balancer
+ * @param [in] balancer: balancer to browse
+ * @return the name of the policy
+ */
+const char *s_balancer_get_name(const struct s_balancer *balancer);
+
+/**
+ * @brief Pick the connected and writable peer to route a message to
+ * @param [in] balancer: balancer to use
+ * @return a peer on success, NULL if none is available
+ */
+struct s_peer *s_balancer_pick(struct s_balancer *balancer);
+
+/**
+ * @brief Find the peer a candidate should replace once the connections are
+ * limited: the most loaded connected peer, if its load is at least twice the
+ * one advertised by the candidate. The round robin policy keeps the first
+ * peers
+ * @param [in] balancer: balancer to use
+ * @param [in] load: load advertised by the candidate
+ * @return a peer to replace, NULL if the candidate is not worth it
+ */
+struct s_peer *s_balancer_get_worst(struct s_balancer *balancer,
+  const struct s_peer_load *load);
+
+/**
+ * @brief Get the counters of a balancer
+ * @param [in] balancer: balancer to browse
+ * @param [out] stats: counters
+ * @return 0 on success, an -errno value on error
+ */
+int s_balancer_get_stats(const struct s_balancer *balancer,
+  struct s_balancer_stats *stats);
+
+#endif /* !_DAEMON_BALANCER_H_ */
@@ -15,17 +15,17 @@
  * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <arpa/inet.h>
 #include <libdaemon/dlog.h>
+#include <stdlib.h>
 #include <sys/eventfd.h>
 
+#include "daemon-address.h"
 #include "daemon-alloc.h"
 #include "daemon-cond.h"
 #include "daemon-ctx.h"
+#include "daemon-peers.h"
 #include "avahi/avahi-browser.h"
-#include "ssl/ssl-client.h"
-
-static const char *_g_cert_path = "/home/siroz/Project/mytank/certificate";
+#include "avahi/avahi-service.h"
 
 /**
  * @brief Call when an error occured.
@@ -39,6 +39,58 @@ static void _s_daemon_ctx_failure(struct s_daemon_ctx *ctx, int error)
   daemon_log(LOG_ERR, "an error occured '%s'\n", strerror(error));
 }
 
+/**
+ * @brief Read the load advertised by a service, a missing key counts as 0
+ * @param [in] data: service data to browse
+ * @param [out] load: advertised load
+ */
+static void _s_daemon_ctx_load(const struct s_browser_data *data,
+  struct s_peer_load *load)
+{
+  const char *connections = s_browser_data_get_txt(data,
+    SERVICE_LOAD_CONNECTIONS);
+  const char *cpu = s_browser_data_get_txt(data, SERVICE_LOAD_CPU);
+  const char *queue = s_browser_data_get_txt(data, SERVICE_LOAD_QUEUE);
+
+  load->connections = connections ? strtoul(connections, NULL, 10) : 0;
+  load->cpu = cpu ? strtoul(cpu, NULL, 10) : 0;
+  load->queue = queue ? strtoul(queue, NULL, 10) : 0;
+}
+
+/**
+ * @brief Decide if a discovered service is worth a connection. Once the
+ * outbound peers reach the limit, the service replaces the most loaded peer
+ * if the balancer finds one, otherwise it is left aside
+ * @param [in] ctx: daemon context
+ * @param [in] key: key of the service
+ * @param [in] name: name of the service
+ * @param [in] load: load advertised by the service
+ * @return 0 to connect the service, other value otherwise
+ */
+static int _s_daemon_ctx_admit(struct s_daemon_ctx *ctx, const char *key,
+  const char *name, const struct s_peer_load *load)
+{
+  int state = s_peers_get_state(ctx->peers, key);
+
+  if (!ctx->limit || (state >= 0 && state != e_peer_state_closed) ||
+      s_peers_get_outbound(ctx->peers) < ctx->limit)
+    return 0;
+
+  struct s_peer *worst = s_balancer_get_worst(ctx->balancer, load);
+  if (!worst) {
+    daemon_log(LOG_INFO, "cerebellum '%s' left aside, %u peers connected\n",
+      name, ctx->limit);
+    return 1;
+  }
+
+  daemon_log(LOG_NOTICE, "cerebellum '%s' replaces '%s'\n", name, worst->name);
+  /* the key goes away with the peer */
+  char *evicted = strdup(worst->key);
+  s_peers_remove(ctx->peers, evicted);
+  daemon_free(evicted);
+  return 0;
+}
+
 /**
  * @brief Call when a service is found
  * @param [in] ctx: userdata passing through the allocation
@@ -55,25 +107,65 @@ static void _s_daemon_ctx_find(struct s_daemon_ctx *ctx,
 
   daemon_log(LOG_NOTICE, "cerebellum '%s' found\n", data->name);
 
-  struct sockaddr_in sin = { 0, };
-  memset(&sin, '0', sizeof(sin));
-  sin.sin_family = AF_INET;
-  sin.sin_port = htons(8000);
-  /* Convert IPv4 and IPv6 addresses from text to binary form */
-  if (inet_pton(AF_INET, data->address, &sin.sin_addr) <= 0) {
-    daemon_log(LOG_ERR, "inet_pton failed\n");
+  struct sockaddr_storage *addresses = daemon_calloc(data->address_count,
+    sizeof(struct sockaddr_storage));
+  uint32_t count = 0;
+  /* Convert IPv4 and IPv6 addresses from text to binary form, a link local
+   * IPv6 address is scoped to the interface it was resolved on */
+  for (uint32_t i = 0; i < data->address_count; ++i) {
+    if (s_address_parse(data->addresses[i].address, data->port,
+        data->addresses[i].interface, &addresses[count]) == 0)
+      ++count;
+  }
+  if (!count) {
+    daemon_log(LOG_ERR, "no valid address for '%s'\n", data->name);
     goto error;
   }
+  s_address_interleave(addresses, count);
 
-  ctx->connection = s_ssl_client_new(ctx->loop, s_daemon_ctx_ssl_get_funcs(),
-    ctx);
-  s_ssl_client_connect(ctx->connection, _g_cert_path, &sin);
+  struct s_peer_load load;
+  _s_daemon_ctx_load(data, &load);
+
+  char *key = s_peers_key(data->name, data->type, data->domain);
+  if (_s_daemon_ctx_admit(ctx, key, data->name, &load) == 0) {
+    int ret = s_peers_add(ctx->peers, key, data->name, addresses, count);
+    if (ret == -EALREADY)
+      daemon_log(LOG_INFO, "cerebellum '%s' already connected\n", data->name);
+    else if (ret < 0)
+      daemon_log(LOG_ERR, "failed to connect '%s'\n", data->name);
+  }
+  /* kept for a known peer, a new announce of a connected one updates it */
+  s_peers_set_load(ctx->peers, key, &load);
+  daemon_free(key);
 
 error:
+  daemon_free(addresses);
   s_browser_data_free(data);
   return;
 }
 
+/**
+ * @brief Call before a service is found, only the services publishing the
+ * cerebellum identifier are worth a connection
+ * @param [in] ctx: userdata passing through the allocation
+ * @param [in] data: service data to check
+ * @return 0 to accept the service, other value otherwise
+ */
+static int _s_daemon_ctx_filter(struct s_daemon_ctx *ctx,
+  const struct s_browser_data *data)
+{
+  daemon_return_val_if_fail(ctx, -EINVAL);
+  daemon_return_val_if_fail(data, -EINVAL);
+
+  const char *id = s_browser_data_get_txt(data, SERVICE_ID);
+  if (!id || s_service_check(id) != 0) {
+    daemon_log(LOG_INFO, "cerebellum '%s' ignored, unknown identifier\n",
+      data->name);
+    return 1;
+  }
+  return 0;
+}
+
 /**
  * @brief Call when a service is removed
  * @param [in] ctx: userdata passing through the allocation
@@ -85,13 +177,18 @@ static void _s_daemon_ctx_remove(struct s_daemon_ctx *ctx,
   daemon_return_if_fail(ctx);
   daemon_return_if_fail(data);
 
-  daemon_log(LOG_NOTICE, "service removed\n");
+  char *key = s_peers_key(data->name, data->type, data->domain);
+  if (s_peers_remove(ctx->peers, key) == 0)
+    daemon_log(LOG_NOTICE, "cerebellum '%s' removed, %u peers left\n",
+      data->name, s_peers_get_count(ctx->peers));
+  daemon_free(key);
 }
 
 const struct s_browser_funcs *s_daemon_ctx_browser_get_funcs(void)
 {
   static struct s_browser_funcs funcs = {
     .failure = (s_browser_failure_cbk)_s_daemon_ctx_failure,
+    .filter = (s_browser_filter_cbk)_s_daemon_ctx_filter,
     .find = (s_browser_find_cbk)_s_daemon_ctx_find,
     .remove = (s_browser_remove_cbk)_s_daemon_ctx_remove
   };
@@ -34,9 +34,13 @@ static void _s_daemon_ctx_client_running(struct s_daemon_ctx *ctx)
 
   daemon_log(LOG_NOTICE, "daemon is running\n");
 
-  struct s_service_data *data = s_service_generate();
-  ctx->browser = s_browser_new(ctx->client, data,
-    s_daemon_ctx_browser_get_funcs(), ctx);
+  /* running again after a host name collision, only the service needs to
+   * be published again */
+  if (!ctx->browser)
+    ctx->browser = s_browser_new(ctx->client, s_service_generate(),
+      s_daemon_ctx_browser_get_funcs(), ctx);
+  if (s_daemon_ctx_publish(ctx) < 0)
+    daemon_log(LOG_ERR, "failed to publish the daemon service\n");
 
   daemon_log(LOG_NOTICE, "daemon is ready\n");
 }
@@ -51,6 +55,7 @@ static void _s_daemon_ctx_client_collision(struct s_daemon_ctx *ctx)
   daemon_return_if_fail(ctx);
 
   daemon_log(LOG_NOTICE, "cerebellum client detected a collision\n");
+  s_daemon_ctx_withdraw(ctx);
 }
 
 /**
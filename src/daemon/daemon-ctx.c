@@ -15,14 +15,72 @@
  * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <inttypes.h>
 #include <libdaemon/dlog.h>
+#include <netinet/in.h>
 #include "daemon-alloc.h"
 #include "daemon-cond.h"
 #include "daemon-ctx.h"
+#include "daemon-group.h"
 #include "daemon-loop.h"
+#include "daemon-peers.h"
+#include "daemon-timer.h"
+#include "daemon-workers.h"
 #include "avahi/avahi-browser.h"
 #include "avahi/avahi-client.h"
+#include "avahi/avahi-group.h"
+#include "avahi/avahi-service.h"
 #include "ssl/ssl-client.h"
+#include "ssl/ssl-context.h"
+#include "ssl/ssl-server.h"
+
+static const char *_g_cert_path = "/home/siroz/Project/mytank/certificate";
+static const char *_g_key_path = "/home/siroz/Project/mytank/private_key";
+
+/**
+ * @brief Accept the inbound peers on the advertised port, with a listener per
+ * loop of the group sharing the port. On error, the listeners already started
+ * keep running
+ * @param [in] ctx: daemon context
+ * @return 0 on success, an -errno value on error
+ */
+static int _s_daemon_ctx_listen(struct s_daemon_ctx *ctx)
+{
+  struct sockaddr_storage address = { 0, };
+  struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&address;
+  struct sockaddr_in *sin = (struct sockaddr_in *)&address;
+  uint32_t count = s_loop_group_get_count(ctx->group);
+
+  /* dual stack wildcard, the IPv4 peers connect through mapped addresses */
+  sin6->sin6_family = AF_INET6;
+  sin6->sin6_port = htons(SERVICE_PORT);
+  sin6->sin6_addr = in6addr_any;
+
+  ctx->servers = daemon_calloc(count, sizeof(struct s_ssl_server *));
+  for (uint32_t i = 0; i < count; i++) {
+    struct s_ssl_server *server = s_ssl_server_new(
+      s_loop_group_get(ctx->group, i), _g_cert_path, _g_key_path,
+      (s_ssl_accept_cbk)s_peers_accept, ctx->peers);
+    daemon_return_val_if_fail(server, -EBADE);
+
+    int ret = s_ssl_server_listen(server, &address);
+    if (ret == -EAFNOSUPPORT && i == 0) {
+      /* a kernel without IPv6 only listens on IPv4 */
+      memset(&address, 0, sizeof(address));
+      sin->sin_family = AF_INET;
+      sin->sin_port = htons(SERVICE_PORT);
+      sin->sin_addr.s_addr = htonl(INADDR_ANY);
+      ret = s_ssl_server_listen(server, &address);
+    }
+    /* not listening, so no event of the group loop refers to it yet */
+    if (ret < 0) {
+      s_ssl_server_free(server);
+      return ret;
+    }
+    ctx->servers[i] = server;
+  }
+  return 0;
+}
 
 /**
  * @brief Event callback raised if a signal is received
@@ -38,21 +96,41 @@ static void _s_daemon_ctx_signal_received(daemon_unused evutil_socket_t fd,
   s_daemon_ctx_quit(ctx);
 }
 
-struct s_daemon_ctx *s_daemon_ctx_new(int fd)
+struct s_daemon_ctx *s_daemon_ctx_new(int fd, uint32_t threads,
+  uint8_t ktls)
 {
-  struct s_daemon_ctx *ctx = daemon_malloc(sizeof(struct s_daemon_ctx));
+  if (s_ssl_library_init() < 0)
+    return NULL;
+
+  struct s_daemon_ctx *ctx = daemon_zalloc(sizeof(struct s_daemon_ctx));
   ctx->loop = s_loop_new();
+  ctx->group = s_loop_group_new(threads);
   ctx->client = s_client_new(s_loop_toavahi(ctx->loop),
     ctx, s_daemon_ctx_client_get_funcs());
   ctx->event = event_new(s_loop_tolibevent(ctx->loop), fd, EV_READ,
     (event_callback_fn)_s_daemon_ctx_signal_received, ctx);
+  ctx->handshakes = s_loop_group_new(threads);
+  ctx->workers = s_workers_new(threads);
+  ctx->peers = s_peers_new(ctx->loop, _g_cert_path,
+    s_daemon_ctx_ssl_get_funcs(), ctx->workers, ctx);
+  if (ctx->peers)
+    ctx->balancer = s_balancer_new(ctx->peers,
+      e_balancer_policy_two_choices);
 
-  if (!ctx->client || !ctx->event || !ctx->loop ||
+  if (!ctx->client || !ctx->event || !ctx->group || !ctx->loop ||
+      !ctx->handshakes || !ctx->peers || !ctx->workers || !ctx->balancer ||
+      s_peers_set_handshake_loops(ctx->peers, ctx->handshakes) < 0 ||
+      s_peers_set_ktls(ctx->peers, ktls) < 0 ||
       event_add(ctx->event, NULL) != 0) {
     errno = EBADE;
     goto error;
   }
 
+  /* the announced peers are still reached, only the inbound ones are lost */
+  if (_s_daemon_ctx_listen(ctx) < 0)
+    daemon_log(LOG_WARNING, "failed to listen on port %d, outbound "
+      "connections only\n", SERVICE_PORT);
+
   return ctx;
 
 error:
@@ -70,18 +148,82 @@ void s_daemon_ctx_free(struct s_daemon_ctx *ctx)
 
   if (ctx->browser)
     s_browser_free(ctx->browser);
-  if (ctx->connection)
-    s_ssl_client_free(ctx->connection);
+  if (ctx->load)
+    s_timer_free(ctx->load);
+  if (ctx->service)
+    s_group_free(ctx->service);
+  /* the inbound peers and the servers belong to the group threads */
+  if (ctx->group)
+    s_loop_group_stop(ctx->group);
+  if (ctx->handshakes)
+    s_loop_group_stop(ctx->handshakes);
+  if (ctx->servers) {
+    for (uint32_t i = 0; i < s_loop_group_get_count(ctx->group); i++)
+      if (ctx->servers[i])
+        s_ssl_server_free(ctx->servers[i]);
+    daemon_free(ctx->servers);
+  }
+  if (ctx->balancer)
+    s_balancer_free(ctx->balancer);
+  if (ctx->peers) {
+    struct s_peer_stats stats;
+
+    if (s_peers_get_stats(ctx->peers, &stats) == 0)
+      daemon_log(LOG_INFO, "peers: %" PRIu64 " connections, %" PRIu64
+        " errors, %" PRIu64 " frames / %" PRIu64 " bytes received, %" PRIu64
+        " messages / %" PRIu64 " bytes sent\n", stats.connections,
+        stats.errors, stats.frames_received, stats.bytes_received,
+        stats.messages_sent, stats.bytes_sent);
+    s_peers_free(ctx->peers);
+  }
+  /* the completions still posted are dropped with the loops */
+  if (ctx->workers)
+    s_workers_free(ctx->workers);
+  if (ctx->handshakes)
+    s_loop_group_free(ctx->handshakes);
   s_client_free(ctx->client);
+  if (ctx->group)
+    s_loop_group_free(ctx->group);
   s_loop_free(ctx->loop);
+  s_ssl_library_deinit();
+}
+
+int s_daemon_ctx_set_balancer(struct s_daemon_ctx *ctx,
+  enum e_balancer_policy policy, uint32_t limit)
+{
+  daemon_return_val_if_fail(ctx, -EINVAL);
+
+  struct s_balancer *balancer = s_balancer_new(ctx->peers, policy);
+  if (!balancer)
+    return -ENOMEM;
+
+  if (ctx->balancer)
+    s_balancer_free(ctx->balancer);
+  ctx->balancer = balancer;
+  ctx->limit = limit;
+  daemon_log(LOG_INFO, "peers selected by %s, %u outbound at most\n",
+    s_balancer_get_name(balancer), limit);
+  return 0;
 }
 
 int s_daemon_ctx_run(struct s_daemon_ctx *ctx)
 {
   daemon_return_val_if_fail(ctx, -EINVAL);
 
-  int ret = s_client_run(ctx->client);
+  int ret = s_loop_group_start(ctx->handshakes);
+  if (ret < 0)
+    return ret;
+
+  ret = s_loop_group_start(ctx->group);
+  if (ret < 0) {
+    s_loop_group_stop(ctx->handshakes);
+    return ret;
+  }
+
+  ret = s_client_run(ctx->client);
   ret |= s_loop_run(ctx->loop);
+  s_loop_group_stop(ctx->group);
+  s_loop_group_stop(ctx->handshakes);
   return ret;
 }
 
@@ -18,20 +18,63 @@
 #ifndef _DAEMON_CTX_H_
 # define _DAEMON_CTX_H_
 
+# include <stdint.h>
+# include "daemon-balancer.h"
+# include "ssl/ssl-frame.h"
+
+/**
+ * @brief Daemon context. Avahi, the signals and the outbound peers run on the
+ * control @loop, the inbound peers are accepted by one server per loop of
+ * @group. The outbound peers are limited to @limit, 0 for no limit
+ */
 struct s_daemon_ctx {
+  struct s_balancer *balancer;
   struct s_browser *browser;
   struct s_client *client;
-  struct s_ssl_client *connection;
   struct event *event;
+  struct s_loop_group *group;
+  struct s_loop_group *handshakes;
+  uint32_t limit;
+  struct s_timer *load;
   struct s_loop *loop;
+  struct s_peers *peers;
+  struct s_ssl_server **servers;
+  struct s_group *service;
+  struct s_workers *workers;
 };
 
 /**
  * @brief Allocate a new context for the daemon
  * @param [in] fd: daemon signal file descriptor
+ * @param [in] threads: number of loop threads, 0 for one per online core
+ * @param [in] ktls: 1 to let the kernel encrypt the records, when supported
  * @return a valid pointer on success, NULL on error
  */
-struct s_daemon_ctx *s_daemon_ctx_new(int fd);
+struct s_daemon_ctx *s_daemon_ctx_new(int fd, uint32_t threads,
+  uint8_t ktls);
+
+/**
+ * @brief Set the policy selecting the peers, by default the two choices
+ * policy without connection limit
+ * @param [in] ctx: context to modify
+ * @param [in] policy: selection policy
+ * @param [in] limit: maximum number of outbound peers, 0 for no limit. Once
+ * reached, a discovered peer only replaces a much more loaded one
+ * @return 0 on success, an -errno value on error
+ */
+int s_daemon_ctx_set_balancer(struct s_daemon_ctx *ctx,
+  enum e_balancer_policy policy, uint32_t limit);
+
+/**
+ * @brief Route a frame to the outbound peer picked by the balancer, on the
+ * control loop
+ * @param [in] ctx: daemon context
+ * @param [in] frame: frame to send
+ * @return 0 on success, -EAGAIN if no peer is writable, an -errno value on
+ * error
+ */
+int s_daemon_ctx_send(struct s_daemon_ctx *ctx,
+  const struct s_ssl_frame *frame);
 
 /**
  * @brief Deallocate a specific context
@@ -65,6 +108,21 @@ const struct s_client_funcs *s_daemon_ctx_client_get_funcs(void);
  */
 const struct s_browser_funcs *s_daemon_ctx_browser_get_funcs(void);
 
+/**
+ * @brief Publish the daemon service along with its load, once the client is
+ * running
+ * @param [in] ctx: context to publish
+ * @return 0 on success, an -errno value on error
+ */
+int s_daemon_ctx_publish(struct s_daemon_ctx *ctx);
+
+/**
+ * @brief Withdraw the daemon service, when the host name collides
+ * @param [in] ctx: context to withdraw
+ * @return 0 on success, an -errno value on error
+ */
+int s_daemon_ctx_withdraw(struct s_daemon_ctx *ctx);
+
 /**
  * @brief Get the ssl behavior function
  * @return a valid pointer on success
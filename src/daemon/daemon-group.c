@@ -0,0 +1,137 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libdaemon/dlog.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-group.h"
+
+struct s_loop_thread {
+  struct s_loop *loop;
+  uint8_t running;
+  pthread_t thread;
+};
+
+struct s_loop_group {
+  uint32_t count;
+  struct s_loop_thread *threads;
+};
+
+/**
+ * @brief Thread entry point, runs a loop until it quits
+ * @param [in] thread: thread representation
+ * @return NULL
+ */
+static void *_s_loop_group_run(struct s_loop_thread *thread)
+{
+  if (s_loop_run(thread->loop) < 0)
+    daemon_log(LOG_ERR, "loop thread failed\n");
+  return NULL;
+}
+
+struct s_loop_group *s_loop_group_new(uint32_t count)
+{
+  if (count == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    count = cores > 0 ? cores : 1;
+  }
+
+  struct s_loop_group *group = daemon_zalloc(sizeof(struct s_loop_group));
+  group->threads = daemon_calloc(count, sizeof(struct s_loop_thread));
+  group->count = count;
+
+  for (uint32_t i = 0; i < count; i++) {
+    group->threads[i].loop = s_loop_new();
+    if (!group->threads[i].loop)
+      goto error;
+  }
+  return group;
+
+error:
+  daemon_log(LOG_ERR, "failed to allocate a loop group\n");
+  s_loop_group_free(group);
+  return NULL;
+}
+
+void s_loop_group_free(struct s_loop_group *group)
+{
+  daemon_return_if_fail(group);
+
+  s_loop_group_stop(group);
+  for (uint32_t i = 0; i < group->count; i++)
+    if (group->threads[i].loop)
+      s_loop_free(group->threads[i].loop);
+  daemon_free(group->threads);
+  daemon_free(group);
+}
+
+int s_loop_group_start(struct s_loop_group *group)
+{
+  daemon_return_val_if_fail(group, -EINVAL);
+
+  for (uint32_t i = 0; i < group->count; i++) {
+    struct s_loop_thread *thread = &group->threads[i];
+    if (thread->running)
+      continue;
+
+    int ret = pthread_create(&thread->thread, NULL,
+      (void *(*)(void *))_s_loop_group_run, thread);
+    if (ret != 0) {
+      daemon_log(LOG_ERR, "failed to start a loop thread '%s'\n",
+        strerror(ret));
+      s_loop_group_stop(group);
+      return -ret;
+    }
+    thread->running = 1;
+  }
+  return 0;
+}
+
+int s_loop_group_stop(struct s_loop_group *group)
+{
+  daemon_return_val_if_fail(group, -EINVAL);
+
+  for (uint32_t i = 0; i < group->count; i++)
+    if (group->threads[i].running)
+      s_loop_quit(group->threads[i].loop);
+
+  for (uint32_t i = 0; i < group->count; i++) {
+    struct s_loop_thread *thread = &group->threads[i];
+    if (!thread->running)
+      continue;
+    pthread_join(thread->thread, NULL);
+    thread->running = 0;
+  }
+  return 0;
+}
+
+uint32_t s_loop_group_get_count(const struct s_loop_group *group)
+{
+  daemon_return_val_if_fail(group, 0);
+
+  return group->count;
+}
+
+struct s_loop *s_loop_group_get(struct s_loop_group *group, uint32_t index)
+{
+  daemon_return_val_if_fail(group, NULL);
+  daemon_return_val_if_fail(index < group->count, NULL);
+
+  return group->threads[index].loop;
+}
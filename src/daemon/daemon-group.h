@@ -0,0 +1,72 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DAEMON_GROUP_H_
+# define _DAEMON_GROUP_H_
+
+# include <stdint.h>
+# include "daemon-loop.h"
+
+/**
+ * @brief Group of loops, each one running on its own thread. The loops are
+ * independent: an object allocated on a loop must only be used by its thread
+ */
+struct s_loop_group;
+
+/**
+ * @brief Allocate a new group of loops
+ * @param [in] count: number of loops, 0 for one per online core
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_loop_group *s_loop_group_new(uint32_t count);
+
+/**
+ * @brief Deallocate a specific group, its threads are stopped first
+ * @param [in] group: group to delete
+ */
+void s_loop_group_free(struct s_loop_group *group);
+
+/**
+ * @brief Start a thread per loop
+ * @param [in] group: group to start
+ * @return 0 on success, an -errno value on error
+ */
+int s_loop_group_start(struct s_loop_group *group);
+
+/**
+ * @brief Quit every loop and wait for the end of their threads
+ * @param [in] group: group to stop
+ * @return 0 on success, an -errno value on error
+ */
+int s_loop_group_stop(struct s_loop_group *group);
+
+/**
+ * @brief Get the number of loops of a group
+ * @param [in] group: group to browse
+ * @return the number of loops
+ */
+uint32_t s_loop_group_get_count(const struct s_loop_group *group);
+
+/**
+ * @brief Get a loop of a group
+ * @param [in] group: group to browse
+ * @param [in] index: loop index, lower than #s_loop_group_get_count
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_loop *s_loop_group_get(struct s_loop_group *group, uint32_t index);
+
+#endif /* !_DAEMON_GROUP_H_ */
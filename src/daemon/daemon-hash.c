@@ -0,0 +1,196 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libdaemon/dlog.h>
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-hash.h"
+
+/**
+ * @brief Initial number of buckets, always a power of two
+ */
+#define HASH_BUCKETS_MIN 16
+
+struct s_hash_entry {
+  struct s_hash_entry *next;
+  uint32_t hash;
+  void *value;
+  char key[];
+};
+
+struct s_hash {
+  struct s_hash_entry **buckets;
+  uint32_t count;
+  s_hash_free_cbk release;
+  uint32_t size;
+};
+
+/**
+ * @brief FNV-1a hash of a string
+ * @param [in] key: string to hash
+ * @return the hash value
+ */
+static uint32_t _s_hash_key(const char *key)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*key) {
+    hash ^= (uint8_t)*key++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Find the link pointing on the entry of a key
+ * @param [in] hash: table to browse
+ * @param [in] key: key to look for
+ * @param [in] value: hash of the key
+ * @return the link, pointing on NULL if not found
+ */
+static struct s_hash_entry **_s_hash_find(const struct s_hash *hash,
+  const char *key, uint32_t value)
+{
+  struct s_hash_entry **link = &hash->buckets[value & (hash->size - 1)];
+
+  while (*link && ((*link)->hash != value || strcmp((*link)->key, key) != 0))
+    link = &(*link)->next;
+  return link;
+}
+
+/**
+ * @brief Double the number of buckets and dispatch the entries again
+ * @param [in] hash: table to grow
+ */
+static void _s_hash_grow(struct s_hash *hash)
+{
+  uint32_t size = hash->size * 2;
+  struct s_hash_entry **buckets = daemon_calloc(size,
+    sizeof(struct s_hash_entry *));
+
+  for (uint32_t i = 0; i < hash->size; ++i) {
+    struct s_hash_entry *entry = hash->buckets[i];
+    while (entry) {
+      struct s_hash_entry *next = entry->next;
+      entry->next = buckets[entry->hash & (size - 1)];
+      buckets[entry->hash & (size - 1)] = entry;
+      entry = next;
+    }
+  }
+  daemon_free(hash->buckets);
+  hash->buckets = buckets;
+  hash->size = size;
+}
+
+struct s_hash *s_hash_new(s_hash_free_cbk release)
+{
+  struct s_hash *hash = daemon_zalloc(sizeof(struct s_hash));
+  hash->buckets = daemon_calloc(HASH_BUCKETS_MIN,
+    sizeof(struct s_hash_entry *));
+  hash->release = release;
+  hash->size = HASH_BUCKETS_MIN;
+  return hash;
+}
+
+void s_hash_free(struct s_hash *hash)
+{
+  daemon_return_if_fail(hash);
+
+  for (uint32_t i = 0; i < hash->size; ++i) {
+    struct s_hash_entry *entry = hash->buckets[i];
+    while (entry) {
+      struct s_hash_entry *next = entry->next;
+      if (hash->release)
+        hash->release(entry->value);
+      daemon_free(entry);
+      entry = next;
+    }
+  }
+  daemon_free(hash->buckets);
+  daemon_free(hash);
+}
+
+int s_hash_insert(struct s_hash *hash, const char *key, void *value)
+{
+  daemon_return_val_if_fail(hash, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+
+  uint32_t _hash = _s_hash_key(key);
+  struct s_hash_entry **link = _s_hash_find(hash, key, _hash);
+  if (*link)
+    return -EEXIST;
+
+  size_t size = strlen(key) + 1;
+  struct s_hash_entry *entry = daemon_malloc(sizeof(struct s_hash_entry) +
+    size);
+  memcpy(entry->key, key, size);
+  entry->hash = _hash;
+  entry->next = NULL;
+  entry->value = value;
+  *link = entry;
+
+  /* keep the load factor under 3/4 */
+  if (++hash->count > hash->size / 4 * 3)
+    _s_hash_grow(hash);
+  return 0;
+}
+
+void *s_hash_lookup(const struct s_hash *hash, const char *key)
+{
+  daemon_return_val_if_fail(hash, NULL);
+  daemon_return_val_if_fail(key, NULL);
+
+  struct s_hash_entry *entry = *_s_hash_find(hash, key, _s_hash_key(key));
+  return entry ? entry->value : NULL;
+}
+
+int s_hash_remove(struct s_hash *hash, const char *key)
+{
+  daemon_return_val_if_fail(hash, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+
+  struct s_hash_entry **link = _s_hash_find(hash, key, _s_hash_key(key));
+  struct s_hash_entry *entry = *link;
+  if (!entry)
+    return -ENOENT;
+
+  *link = entry->next;
+  hash->count--;
+  if (hash->release)
+    hash->release(entry->value);
+  daemon_free(entry);
+  return 0;
+}
+
+uint32_t s_hash_get_count(const struct s_hash *hash)
+{
+  daemon_return_val_if_fail(hash, 0);
+
+  return hash->count;
+}
+
+void s_hash_foreach(const struct s_hash *hash, s_hash_foreach_cbk cbk,
+  void *userdata)
+{
+  daemon_return_if_fail(hash);
+  daemon_return_if_fail(cbk);
+
+  for (uint32_t i = 0; i < hash->size; ++i)
+    for (struct s_hash_entry *entry = hash->buckets[i]; entry;
+         entry = entry->next)
+      cbk(userdata, entry->key, entry->value);
+}
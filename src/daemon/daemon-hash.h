@@ -0,0 +1,100 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DAEMON_HASH_H_
+# define _DAEMON_HASH_H_
+
+# include <stdint.h>
+
+/**
+ * @brief String keyed hash table, the keys are copied and the values are
+ * owned by the table
+ */
+struct s_hash;
+
+/**
+ * @brief Value release callback, called when a value leaves the table
+ * @param [in] value: value to release
+ */
+typedef void (*s_hash_free_cbk)(void *value);
+
+/**
+ * @brief Iteration callback
+ * @param [in] userdata: userdata given to #s_hash_foreach
+ * @param [in] key: key of the entry
+ * @param [in] value: value of the entry
+ */
+typedef void (*s_hash_foreach_cbk)(void *userdata, const char *key,
+  void *value);
+
+/**
+ * @brief Allocate a new hash table
+ * @param [in] release: value release callback, can be NULL
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_hash *s_hash_new(s_hash_free_cbk release);
+
+/**
+ * @brief Deallocate a specific hash table and release every value
+ * @param [in] hash: table to delete
+ */
+void s_hash_free(struct s_hash *hash);
+
+/**
+ * @brief Insert a value
+ * @param [in] hash: table to modify
+ * @param [in] key: key of the value, copied
+ * @param [in] value: value to store
+ * @return 0 on success, -EEXIST if the key is already used, an -errno value
+ * on error
+ */
+int s_hash_insert(struct s_hash *hash, const char *key, void *value);
+
+/**
+ * @brief Look up a value
+ * @param [in] hash: table to browse
+ * @param [in] key: key to look for
+ * @return the value on success, NULL if not found
+ */
+void *s_hash_lookup(const struct s_hash *hash, const char *key);
+
+/**
+ * @brief Remove a value and release it
+ * @param [in] hash: table to modify
+ * @param [in] key: key to remove
+ * @return 0 on success, -ENOENT if not found, an -errno value on error
+ */
+int s_hash_remove(struct s_hash *hash, const char *key);
+
+/**
+ * @brief Get the number of entries
+ * @param [in] hash: table to browse
+ * @return the number of entries
+ */
+uint32_t s_hash_get_count(const struct s_hash *hash);
+
+/**
+ * @brief Call a function on every entry, the table must not be modified
+ * during the iteration
+ * @param [in] hash: table to browse
+ * @param [in] cbk: function to call
+ * @param [in] userdata: userdata given to @cbk
+ */
+void s_hash_foreach(const struct s_hash *hash, s_hash_foreach_cbk cbk,
+  void *userdata);
+
+#endif /* !_DAEMON_HASH_H_ */
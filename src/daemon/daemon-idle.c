@@ -22,30 +22,77 @@
 #include "daemon-cond.h"
 #include "daemon-idle.h"
 
+/**
+ * @brief Posted closure, an element of the lock-free task stack
+ */
+struct s_task {
+  s_task_cbk cbk;
+  struct s_task *next;
+  void *userdata;
+};
+
 struct s_task_idle {
-  int32_t fd;
+  uint64_t batches;
   struct event *event;
+  int32_t fd;
+  struct s_task *head;
+  struct s_loop *loop;
+  uint64_t tasks;
 };
 
 /**
  * @brief Exit ordered by the user. Must quit the event loop
+ * @param [in] loop: loop to quit
  */
-static void _s_task_idle_cbk(daemon_unused evutil_socket_t fd,
-  daemon_unused short e, struct s_loop *loop)
+static void _s_task_idle_quit(struct s_loop *loop)
 {
   daemon_return_if_fail(loop);
 
   event_base_loopexit(s_loop_tolibevent(loop), NULL);
 }
 
+/**
+ * @brief Run every posted task, in posting order. Producers only signal the
+ * eventfd when the stack was empty, so a single wakeup covers a whole batch
+ */
+static void _s_task_idle_cbk(evutil_socket_t fd, daemon_unused short e,
+  struct s_task_idle *task)
+{
+  uint64_t count;
+
+  /* acknowledge before taking the stack, a later post wakes us again */
+  if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    daemon_log(LOG_ERR, "failed to read the task eventfd\n");
+
+  struct s_task *head = __atomic_exchange_n(&task->head, NULL,
+    __ATOMIC_ACQUIRE);
+  struct s_task *ordered = NULL;
+  while (head) {
+    struct s_task *next = head->next;
+    head->next = ordered;
+    ordered = head;
+    head = next;
+  }
+
+  task->batches++;
+  while (ordered) {
+    struct s_task *next = ordered->next;
+    ordered->cbk(ordered->userdata);
+    daemon_free(ordered);
+    ordered = next;
+    task->tasks++;
+  }
+}
+
 struct s_task_idle *s_task_idle_new(struct s_loop *loop)
 {
   daemon_return_val_if_fail(loop, NULL);
 
-  struct s_task_idle *task = daemon_malloc(sizeof(struct s_task_idle));
-  task->fd = eventfd(0, EFD_NONBLOCK);
-  task->event = event_new(s_loop_tolibevent(loop), task->fd, EV_READ,
-    (event_callback_fn)_s_task_idle_cbk, loop);
+  struct s_task_idle *task = daemon_zalloc(sizeof(struct s_task_idle));
+  task->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  task->loop = loop;
+  task->event = event_new(s_loop_tolibevent(loop), task->fd,
+    EV_READ | EV_PERSIST, (event_callback_fn)_s_task_idle_cbk, task);
 
   if (task->fd < 0 || !task->event || event_add(task->event, NULL) < 0)
     goto error;
@@ -62,16 +109,63 @@ void s_task_idle_free(struct s_task_idle *task)
 {
   daemon_return_if_fail(task);
 
+  struct s_task *head = __atomic_exchange_n(&task->head, NULL,
+    __ATOMIC_ACQUIRE);
+  while (head) {
+    struct s_task *next = head->next;
+    daemon_free(head);
+    head = next;
+  }
+
   close(task->fd);
-  event_del(task->event);
-  event_free(task->event);
+  if (task->event) {
+    event_del(task->event);
+    event_free(task->event);
+  }
   daemon_free(task);
 }
 
+int s_task_idle_post(struct s_task_idle *task, s_task_cbk cbk,
+  void *userdata)
+{
+  daemon_return_val_if_fail(task, -EINVAL);
+  daemon_return_val_if_fail(cbk, -EINVAL);
+
+  struct s_task *node = daemon_malloc(sizeof(struct s_task));
+  node->cbk = cbk;
+  node->userdata = userdata;
+  struct s_task *head = __atomic_load_n(&task->head, __ATOMIC_RELAXED);
+  do {
+    node->next = head;
+  } while (!__atomic_compare_exchange_n(&task->head, &head, node, 1,
+      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  /* the consumer is already signaled for a non empty stack, the node itself
+   * belongs to it once published */
+  if (head)
+    return 0;
+
+  uint64_t u = 1;
+  if (write(task->fd, &u, sizeof(u)) != sizeof(u))
+    return -errno;
+  return 0;
+}
+
 int s_task_idle_wakeup(struct s_task_idle *task)
 {
   daemon_return_val_if_fail(task, -EINVAL);
 
-  uint64_t u = 0xfffffffffffffffe;
-  return !(write(task->fd, &u, sizeof(uint64_t)) != sizeof(uint64_t));
+  return s_task_idle_post(task, (s_task_cbk)_s_task_idle_quit, task->loop);
+}
+
+int s_task_idle_get_stats(const struct s_task_idle *task, uint64_t *tasks,
+  uint64_t *batches)
+{
+  daemon_return_val_if_fail(task, -EINVAL);
+  daemon_return_val_if_fail(tasks, -EINVAL);
+  daemon_return_val_if_fail(batches, -EINVAL);
+
+  *tasks = task->tasks;
+  *batches = task->batches;
+  return 0;
 }
@@ -18,10 +18,13 @@
 #ifndef _DAEMON_IDLE_H_
 # define _DAEMON_IDLE_H_
 
+# include <stdint.h>
 # include "daemon-loop.h"
 
 /**
- * @brief Use to create an idle event and wait for further treatment to do
+ * @brief Task mailbox of a loop. Any thread can post a task, the loop is
+ * woken up once per batch through an eventfd and runs the whole batch in
+ * posting order
  */
 struct s_task_idle;
 
@@ -39,10 +42,31 @@ struct s_task_idle *s_task_idle_new(struct s_loop *loop);
 void s_task_idle_free(struct s_task_idle *idle);
 
 /**
- * @brief Wakeup the task
+ * @brief Post a task, callable from any thread. The pending tasks are dropped
+ * without being run if the mailbox is deallocated first
+ * @param [in] idle: mailbox of the loop
+ * @param [in] cbk: function to run on the loop thread
+ * @param [in] userdata: userdata given to @cbk
+ * @return 0 on success, an -errno value on error
+ */
+int s_task_idle_post(struct s_task_idle *idle, s_task_cbk cbk,
+  void *userdata);
+
+/**
+ * @brief Post a task quitting the loop, callable from any thread
  * @param [in] idle: task to wakeup
- * @return 0 on success, an errno value on error
+ * @return 0 on success, an -errno value on error
  */
 int s_task_idle_wakeup(struct s_task_idle *idle);
 
+/**
+ * @brief Get the counters of a mailbox
+ * @param [in] idle: mailbox to browse
+ * @param [out] tasks: number of tasks run
+ * @param [out] batches: number of wakeups, each one running a batch of tasks
+ * @return 0 on success, an -errno value on error
+ */
+int s_task_idle_get_stats(const struct s_task_idle *idle, uint64_t *tasks,
+  uint64_t *batches);
+
 #endif /* !_DAEMON_IDLE_H_ */
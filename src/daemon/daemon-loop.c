@@ -15,26 +15,57 @@
  * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <inttypes.h>
 #include <libdaemon/dlog.h>
+#include <time.h>
+#include <sys/time.h>
 #include <sys/signal.h>
 #include "daemon-alloc.h"
 #include "daemon-cond.h"
 #include "daemon-idle.h"
 #include "daemon-loop.h"
+#include "daemon-timer.h"
 
 struct s_loop {
   struct event_base *base;
   struct event *signal;
   struct s_task_idle *idle;
+  struct timeval iteration;
+  uint64_t now;
+  struct s_pool *pool;
+  struct s_timer_wheel *wheel;
 };
 
+/**
+ * @brief Allocate a libevent base for the timing wheel
+ * @return a valid pointer on success, NULL on error
+ */
+static struct event_base *_s_loop_base_new(void)
+{
+  struct event_config *config = event_config_new();
+  daemon_return_val_if_fail(config, NULL);
+
+  /* the timing wheel counts milliseconds, the coarse clock lags by a tick */
+  event_config_set_flag(config, EVENT_BASE_FLAG_PRECISE_TIMER);
+  struct event_base *base = event_base_new_with_config(config);
+  event_config_free(config);
+  return base;
+}
+
 struct s_loop *s_loop_new(void)
 {
-  struct s_loop *loop = daemon_malloc(sizeof(struct s_loop));
-  loop->base = event_base_new();
+  struct s_loop *loop = daemon_zalloc(sizeof(struct s_loop));
+  loop->base = _s_loop_base_new();
   loop->idle = s_task_idle_new(loop);
+  loop->pool = s_pool_new();
+  if (loop->base)
+    loop->wheel = s_timer_wheel_new(loop);
+  /* the loops of a group are created by the control thread, they install
+   * their pool when they run */
+  if (!s_pool_get_current())
+    s_pool_set_current(loop->pool);
 
-  if (!loop->base || !loop->idle)
+  if (!loop->base || !loop->idle || !loop->wheel)
     goto error;
 
   return loop;
@@ -51,14 +82,36 @@ void s_loop_free(struct s_loop *loop)
 
   s_loop_quit(loop);
 
+  struct s_pool_stats stats;
+  if (s_pool_get_stats(loop->pool, &stats) == 0)
+    daemon_log(LOG_INFO, "pool: %" PRIu64 " hits, %" PRIu64 " misses, %"
+      PRIu64 " large, %" PRIu64 " drops\n", stats.hits, stats.misses,
+      stats.large, stats.drops);
+
+  uint64_t tasks, batches;
+  if (loop->idle && s_task_idle_get_stats(loop->idle, &tasks, &batches) == 0)
+    daemon_log(LOG_INFO, "tasks: %" PRIu64 " run in %" PRIu64 " batches\n",
+      tasks, batches);
+
+  struct s_timer_stats timers;
+  if (loop->wheel && s_timer_wheel_get_stats(loop->wheel, &timers) == 0)
+    daemon_log(LOG_INFO, "timers: %" PRIu64 " armed, %" PRIu64
+      " cancelled, %" PRIu64 " expired in %" PRIu64 " wakeups\n",
+      timers.armed, timers.cancelled, timers.expired, timers.wakeups);
+  if (loop->wheel)
+    s_timer_wheel_free(loop->wheel);
+
   s_task_idle_free(loop->idle);
   event_base_free(loop->base);
+  s_pool_free(loop->pool);
   daemon_free(loop);
 }
 
 int s_loop_run(struct s_loop *loop)
 {
   daemon_return_val_if_fail(loop, -EINVAL);
+
+  s_pool_set_current(loop->pool);
   return event_base_loop(loop->base, 0);
 }
 
@@ -68,8 +121,82 @@ int s_loop_quit(struct s_loop *loop)
   return s_task_idle_wakeup(loop->idle);
 }
 
+int s_loop_post(struct s_loop *loop, s_task_cbk cbk, void *userdata)
+{
+  daemon_return_val_if_fail(loop, -EINVAL);
+  return s_task_idle_post(loop->idle, cbk, userdata);
+}
+
+/**
+ * @brief Refresh the cached times of a loop. libevent refreshes its cached
+ * time of day once per iteration, the monotonic clock is only read again once
+ * it changed. Outside of the loop callbacks, both are read on every call
+ * @param [in] loop: loop to refresh
+ */
+static void _s_loop_update_time(struct s_loop *loop)
+{
+  struct timeval cached;
+
+  if (event_base_gettimeofday_cached(loop->base, &cached) < 0)
+    (void)gettimeofday(&cached, NULL);
+
+  if (cached.tv_sec != loop->iteration.tv_sec ||
+      cached.tv_usec != loop->iteration.tv_usec || !loop->now) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    loop->iteration = cached;
+    loop->now = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+  }
+}
+
+uint64_t s_loop_now(struct s_loop *loop)
+{
+  daemon_return_val_if_fail(loop, 0);
+
+  _s_loop_update_time(loop);
+  return loop->now;
+}
+
+int s_loop_get_time(struct s_loop *loop, struct timeval *tv)
+{
+  daemon_return_val_if_fail(loop, -EINVAL);
+  daemon_return_val_if_fail(tv, -EINVAL);
+
+  _s_loop_update_time(loop);
+  *tv = loop->iteration;
+  return 0;
+}
+
+uint64_t s_loop_delay_until(struct s_loop *loop, const struct timeval *tv)
+{
+  daemon_return_val_if_fail(loop, 0);
+  daemon_return_val_if_fail(tv, 0);
+
+  struct timeval delay;
+
+  _s_loop_update_time(loop);
+  evutil_timersub(tv, &loop->iteration, &delay);
+  /* normalized, a deadline in the past has a negative second count */
+  if (delay.tv_sec < 0)
+    return 0;
+  return (uint64_t)delay.tv_sec * 1000 + (delay.tv_usec + 999) / 1000;
+}
+
 struct event_base *s_loop_tolibevent(struct s_loop *loop)
 {
   daemon_return_val_if_fail(loop, NULL);
   return loop->base;
 }
+
+struct s_timer_wheel *s_loop_towheel(struct s_loop *loop)
+{
+  daemon_return_val_if_fail(loop, NULL);
+  return loop->wheel;
+}
+
+struct s_pool *s_loop_topool(struct s_loop *loop)
+{
+  daemon_return_val_if_fail(loop, NULL);
+  return loop->pool;
+}
@@ -20,9 +20,19 @@
 
 # include <avahi-common/watch.h>
 # include <event2/event.h>
+# include <stdint.h>
+# include "daemon-pool.h"
 
 struct s_loop;
 
+struct s_timer_wheel;
+
+/**
+ * @brief Task posted to a loop
+ * @param [in] userdata: userdata given with the task
+ */
+typedef void (*s_task_cbk)(void *userdata);
+
 /**
  * @brief Allocate a new module loop
  * @return a valid pointer on success, NULL on error
@@ -49,6 +59,42 @@ int s_loop_run(struct s_loop *loop);
  */
 int s_loop_quit(struct s_loop *loop);
 
+/**
+ * @brief Run a function on the thread of a loop, callable from any thread.
+ * The tasks posted by a thread run in their posting order
+ * @param [in] loop: loop to run the task
+ * @param [in] cbk: function to run
+ * @param [in] userdata: userdata given to @cbk
+ * @return 0 on success, an -errno value on error
+ */
+int s_loop_post(struct s_loop *loop, s_task_cbk cbk, void *userdata);
+
+/**
+ * @brief Get the monotonic time of a loop, read once per loop iteration
+ * @param [in] loop: loop to browse
+ * @return the time in milliseconds, 0 on error
+ */
+uint64_t s_loop_now(struct s_loop *loop);
+
+/**
+ * @brief Get the time of day of a loop, read once per loop iteration along
+ * with #s_loop_now
+ * @param [in] loop: loop to browse
+ * @param [out] tv: time of day
+ * @return 0 on success, an -errno value on error
+ */
+int s_loop_get_time(struct s_loop *loop, struct timeval *tv);
+
+/**
+ * @brief Convert an absolute time of day into a delay from the loop time,
+ * rounded up to the millisecond. The wall clock is only used for this
+ * conversion: once armed, a timer follows the monotonic clock
+ * @param [in] loop: loop to browse
+ * @param [in] tv: absolute time of day
+ * @return the delay in milliseconds, 0 if already passed or on error
+ */
+uint64_t s_loop_delay_until(struct s_loop *loop, const struct timeval *tv);
+
 /**
  * @brief Convert the module loop into libevent loop
  * @param [in] loop: loop to convert
@@ -63,4 +109,19 @@ struct event_base *s_loop_tolibevent(struct s_loop *loop);
  */
 const AvahiPoll *s_loop_toavahi(struct s_loop *loop);
 
+/**
+ * @brief Get the allocation pool owned by the module loop, it is installed on
+ * the thread running the loop
+ * @param [in] loop: loop to browse
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_pool *s_loop_topool(struct s_loop *loop);
+
+/**
+ * @brief Get the timing wheel running the timers of a loop
+ * @param [in] loop: loop to browse
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_timer_wheel *s_loop_towheel(struct s_loop *loop);
+
 #endif /* !_DAEMON_LOOP_H_ */
@@ -33,9 +33,10 @@
 
 /**
  * @brief Start the daemon process
+ * @param [in] options: options given to the daemon process
  * @return 0 on success, an errno value on error
  */
-static int _daemon_fork_process(void)
+static int _daemon_fork_process(struct s_options *options)
 {
   int ret = 0;
 
@@ -57,7 +58,7 @@ static int _daemon_fork_process(void)
       daemon_log(LOG_INFO, "daemon returned value '%d'", ret);
       return ret;
     } else {
-      return daemon_load_process();
+      return daemon_load_process(options);
     }
   }
   daemon_log(LOG_ERR, "process already started");
@@ -116,11 +117,11 @@ int main(int argc, char *argv[])
       ret = daemon_kill_process();
       break;
     case e_process_option_start:
-      ret = _daemon_fork_process();
+      ret = _daemon_fork_process(options);
       break;
     case e_process_option_reload: {
       ret = daemon_kill_process();
-      ret |= _daemon_fork_process();
+      ret |= _daemon_fork_process(options);
     }
     default:
       daemon_log(LOG_ERR, "an error occured...");
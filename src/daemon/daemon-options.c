@@ -15,51 +15,117 @@
  * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
 #include <libdaemon/dlog.h>
 #include "daemon-alloc.h"
 #include "daemon-cond.h"
 #include "daemon-options.h"
 
 struct s_options {
+  char *balancer;
+  uint8_t ktls;
+  uint32_t peers;
   enum e_process_option process;
+  uint32_t threads;
   int32_t verbosity;
 };
 
+/**
+ * @brief Upper bound of the loop threads, each one comes with a handshake loop
+ * and a worker
+ */
+#define OPTIONS_THREADS_MAX 256
+
+/**
+ * @brief Parse a strictly positive count given to an option
+ * @param [in] name: option name, for the error message
+ * @param [in] str: argument of the option
+ * @param [in] max: highest value accepted
+ * @param [out] value: parsed count
+ * @return 0 on success, an -errno value on error
+ */
+static int _s_options_parse_count(const char *name, const char *str,
+  uint32_t max, uint32_t *value)
+{
+  char *end = NULL;
+  unsigned long count;
+
+  /* strtoul silently negates a minus sign */
+  while (isspace((unsigned char)*str))
+    str++;
+  errno = 0;
+  count = *str == '-' ? 0 : strtoul(str, &end, 10);
+  if (errno || !end || end == str || *end || count == 0 || count > max) {
+    daemon_log(LOG_ERR, "invalid --%s '%s', expected 1 to %u\n", name, str,
+      max);
+    return -EINVAL;
+  }
+  *value = count;
+  return 0;
+}
+
 struct s_options *s_options_new(int argc, char *argv[])
 {
-  struct s_options *options = daemon_malloc(sizeof(struct s_options));
+  struct s_options *options = daemon_zalloc(sizeof(struct s_options));
 
+  static const struct option _g_daemon_options[] = {
+    { "balancer", required_argument, 0, 'B' },
+    { "check", no_argument, 0, 'c' },
+    { "kill", no_argument, 0, 'k' },
+    { "ktls", no_argument, 0, 'K' },
+    { "peers", required_argument, 0, 'p' },
+    { "reload", no_argument, 0, 'r' },
+    { "threads", required_argument, 0, 't' },
+    { "verbose", required_argument, 0, 'v' },
+    {0, 0, 0, 0 }
+  };
+  int option_index = 0;
+  int option;
+
+  options->process = e_process_option_start;
   options->verbosity = LOG_WARNING;
-  if (argc > 1) {
-    static const struct option _g_daemon_options[] = {
-      { "check", no_argument, 0, 'c' },
-      { "kill", no_argument, 0, 'k' },
-      { "reload", no_argument, 0, 'r' },
-      { "verbose", required_argument, 0, 'v' },
-      {0, 0, 0, 0 }
-    };
-    int option_index = 0;
-    int option = getopt_long(argc, argv, "crs", _g_daemon_options,
-      &option_index);
+  while ((option = getopt_long(argc, argv, "B:cKkp:rt:", _g_daemon_options,
+      &option_index)) != -1) {
     switch (option) {
+    case 'B':
+      if (options->balancer)
+        daemon_free(options->balancer);
+      options->balancer = strdup(optarg);
+      break;
     case 'c':
       options->process = e_process_option_check;
       break;
     case 'k':
       options->process = e_process_option_kill;
       break;
+    case 'K':
+      options->ktls = 1;
+      break;
+    case 'p':
+      /* not given, every discovered peer is connected */
+      if (_s_options_parse_count("peers", optarg, UINT32_MAX,
+          &options->peers) < 0)
+        options->process = e_process_option_error;
+      break;
     case 'r':
       options->process = e_process_option_reload;
       break;
+    case 't':
+      /* not given, one loop thread is started per online core */
+      if (_s_options_parse_count("threads", optarg, OPTIONS_THREADS_MAX,
+          &options->threads) < 0)
+        options->process = e_process_option_error;
+      break;
     case 'v':
     default:
       daemon_log(LOG_ERR, "unrecognized option '%c'", option);
       options->process = e_process_option_error;
       break;
     }
-  } else {
-    options->process = e_process_option_start;
   }
   return options;
 }
@@ -68,6 +134,8 @@ void s_options_free(struct s_options *options)
 {
   daemon_return_if_fail(options);
 
+  if (options->balancer)
+    daemon_free(options->balancer);
   daemon_free(options);
 }
 
@@ -84,3 +152,31 @@ int32_t s_options_get_verbosity(struct s_options *options)
 
   return options->verbosity;
 }
+
+uint8_t s_options_get_ktls(struct s_options *options)
+{
+  daemon_return_val_if_fail(options, 0);
+
+  return options->ktls;
+}
+
+uint32_t s_options_get_threads(struct s_options *options)
+{
+  daemon_return_val_if_fail(options, 0);
+
+  return options->threads;
+}
+
+const char *s_options_get_balancer(struct s_options *options)
+{
+  daemon_return_val_if_fail(options, NULL);
+
+  return options->balancer;
+}
+
+uint32_t s_options_get_peers(struct s_options *options)
+{
+  daemon_return_val_if_fail(options, 0);
+
+  return options->peers;
+}
@@ -18,6 +18,8 @@
 #ifndef _DAEMON_OPTIONS_H_
 # define _DAEMON_OPTIONS_H_
 
+# include <stdint.h>
+
 enum e_process_option {
   e_process_option_check,
   e_process_option_reload,
@@ -56,4 +58,32 @@ enum e_process_option s_options_get_process_option(struct s_options *options);
  */
 int32_t s_options_get_verbosity(struct s_options *options);
 
+/**
+ * @brief Get the number of loop threads accepting the peers
+ * @param [in] options: options to browse
+ * @return the number of threads, 0 for one per online core
+ */
+uint32_t s_options_get_threads(struct s_options *options);
+
+/**
+ * @brief Check if the kernel must encrypt the records of the peers (kTLS)
+ * @param [in] options: options to browse
+ * @return 1 if enabled, 0 otherwise
+ */
+uint8_t s_options_get_ktls(struct s_options *options);
+
+/**
+ * @brief Get the policy selecting the peers
+ * @param [in] options: options to browse
+ * @return a policy name, NULL for the default one
+ */
+const char *s_options_get_balancer(struct s_options *options);
+
+/**
+ * @brief Get the maximum number of outbound peers
+ * @param [in] options: options to browse
+ * @return the number of peers, 0 for no limit
+ */
+uint32_t s_options_get_peers(struct s_options *options);
+
 #endif /* !_DAEMON_OPTIONS_H_ */
@@ -0,0 +1,591 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <libdaemon/dlog.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "daemon-address.h"
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-hash.h"
+#include "daemon-peers.h"
+#include "ssl/ssl-client.h"
+#include "ssl/ssl-session.h"
+
+/**
+ * @brief Output queue bounds of a peer connection
+ */
+#define PEERS_WRITE_LOW (64 * 1024)
+#define PEERS_WRITE_HIGH (1024 * 1024)
+
+struct s_peers {
+  char *certificate;
+  struct s_ssl_funcs funcs;
+  struct s_loop_group *handshakes;
+  struct s_hash *hash;
+  uint8_t ktls;
+  pthread_mutex_t lock;
+  struct s_loop *loop;
+  struct s_peer_stats removed;
+  struct s_ssl_sessions *sessions;
+  uint32_t spread;
+  void *userdata;
+  struct s_workers *workers;
+};
+
+/**
+ * @brief Add counters to a total
+ * @param [in, out] total: counters to increase
+ * @param [in] stats: counters to add
+ */
+static void _s_peer_stats_add(struct s_peer_stats *total,
+  const struct s_peer_stats *stats)
+{
+  total->bytes_received += stats->bytes_received;
+  total->bytes_sent += stats->bytes_sent;
+  total->connections += stats->connections;
+  total->errors += stats->errors;
+  total->frames_received += stats->frames_received;
+  total->messages_sent += stats->messages_sent;
+}
+
+/**
+ * @brief Close the connection of a peer, its output counters are kept
+ * @param [in] peer: peer to close
+ */
+static void _s_peer_close(struct s_peer *peer)
+{
+  struct s_ssl_client_stats stats;
+
+  if (!peer->client)
+    return;
+
+  if (s_ssl_client_get_stats(peer->client, &stats) == 0) {
+    peer->stats.bytes_sent += stats.bytes;
+    peer->stats.messages_sent += stats.messages;
+  }
+  s_ssl_client_free(peer->client);
+  peer->client = NULL;
+  peer->state = e_peer_state_closed;
+}
+
+/**
+ * @brief Deallocate a peer, release callback of the hash table
+ * @param [in] peer: peer to delete
+ */
+static void _s_peer_free(struct s_peer *peer)
+{
+  daemon_return_if_fail(peer);
+
+  _s_peer_close(peer);
+  if (peer->strand)
+    s_strand_free(peer->strand);
+  if (peer->addresses)
+    daemon_free(peer->addresses);
+  daemon_free(peer->key);
+  daemon_free(peer->name);
+  daemon_free(peer);
+}
+
+/**
+ * @brief Replace the addresses of a peer
+ * @param [in] peer: peer to modify
+ * @param [in] addresses: new addresses
+ * @param [in] count: number of addresses
+ */
+static void _s_peer_set_addresses(struct s_peer *peer,
+  const struct sockaddr_storage *addresses, uint32_t count)
+{
+  size_t size = count * sizeof(struct sockaddr_storage);
+
+  peer->addresses = daemon_realloc(peer->addresses, size);
+  memcpy(peer->addresses, addresses, size);
+  peer->address_count = count;
+}
+
+/**
+ * @brief Allocate the ssl client of a peer on its loop
+ * @param [in] peers: connection manager
+ * @param [in] peer: peer to set up
+ * @return 0 on success, an -errno value on error
+ */
+static int _s_peer_client_new(struct s_peers *peers, struct s_peer *peer)
+{
+  peer->client = s_ssl_client_new(peer->loop, &peers->funcs, peer);
+  daemon_return_val_if_fail(peer->client, -ENOMEM);
+
+  s_ssl_client_set_name(peer->client, peer->name);
+  s_ssl_client_set_ktls(peer->client, peers->ktls);
+  if (peers->handshakes)
+    s_ssl_client_set_handshake_loop(peer->client, s_loop_group_get(
+      peers->handshakes, peers->spread++ %
+        s_loop_group_get_count(peers->handshakes)));
+  s_ssl_client_set_watermarks(peer->client, PEERS_WRITE_LOW,
+    PEERS_WRITE_HIGH);
+
+  peer->connecting = s_loop_now(peer->loop);
+  peer->state = e_peer_state_connecting;
+  peer->stats.connections++;
+  return 0;
+}
+
+/**
+ * @brief Open the connection of a peer
+ * @param [in] peers: connection manager
+ * @param [in] peer: peer to connect
+ * @return 0 on success, an -errno value on error
+ */
+static int _s_peer_connect(struct s_peers *peers, struct s_peer *peer)
+{
+  int ret = _s_peer_client_new(peers, peer);
+  if (ret < 0)
+    return ret;
+
+  s_ssl_client_set_session_cache(peer->client, peers->sessions);
+  ret = s_ssl_client_connect(peer->client, peers->certificate,
+    peer->addresses, peer->address_count);
+  if (ret < 0) {
+    __atomic_add_fetch(&peer->stats.errors, 1, __ATOMIC_RELAXED);
+    _s_peer_close(peer);
+  }
+  return ret;
+}
+
+struct s_peers *s_peers_new(struct s_loop *loop, const char *certificate,
+  const struct s_ssl_funcs *funcs, struct s_workers *workers, void *userdata)
+{
+  daemon_return_val_if_fail(loop, NULL);
+  daemon_return_val_if_fail(certificate, NULL);
+  daemon_return_val_if_fail(s_ssl_funcs_check(funcs) == 0, NULL);
+
+  struct s_peers *peers = daemon_zalloc(sizeof(struct s_peers));
+  peers->certificate = strdup(certificate);
+  peers->funcs = *funcs;
+  peers->hash = s_hash_new((s_hash_free_cbk)_s_peer_free);
+  pthread_mutex_init(&peers->lock, NULL);
+  peers->loop = loop;
+  peers->sessions = s_ssl_sessions_new();
+  peers->userdata = userdata;
+  peers->workers = workers;
+  return peers;
+}
+
+void s_peers_free(struct s_peers *peers)
+{
+  daemon_return_if_fail(peers);
+
+  struct s_ssl_session_stats stats;
+
+  s_hash_free(peers->hash);
+  if (s_ssl_sessions_get_stats(peers->sessions, &stats) == 0)
+    daemon_log(LOG_INFO, "sessions: %" PRIu64 " hits, %" PRIu64 " misses, %"
+      PRIu64 " expired, %" PRIu64 " resumed, %" PRIu64 " full handshakes\n",
+      stats.hits, stats.misses, stats.expired, stats.resumed, stats.full);
+  s_ssl_sessions_free(peers->sessions);
+  pthread_mutex_destroy(&peers->lock);
+  daemon_free(peers->certificate);
+  daemon_free(peers);
+}
+
+char *s_peers_key(const char *name, const char *type, const char *domain)
+{
+  daemon_return_val_if_fail(name, NULL);
+  daemon_return_val_if_fail(type, NULL);
+  daemon_return_val_if_fail(domain, NULL);
+
+  size_t size = strlen(name) + strlen(type) + strlen(domain) + 3;
+  char *key = daemon_malloc(size);
+  snprintf(key, size, "%s.%s.%s", name, type, domain);
+  return key;
+}
+
+int s_peers_add(struct s_peers *peers, const char *key, const char *name,
+  const struct sockaddr_storage *addresses, uint32_t count)
+{
+  daemon_return_val_if_fail(peers, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+  daemon_return_val_if_fail(name, -EINVAL);
+  daemon_return_val_if_fail(addresses, -EINVAL);
+  daemon_return_val_if_fail(count > 0, -EINVAL);
+
+  int ret = -EALREADY;
+
+  pthread_mutex_lock(&peers->lock);
+  struct s_peer *peer = s_hash_lookup(peers->hash, key);
+  if (peer) {
+    /* the same service is reported once per interface and protocol, and
+     * again once its second address family is resolved */
+    _s_peer_set_addresses(peer, addresses, count);
+    if (peer->state != e_peer_state_closed)
+      goto unlock;
+    _s_peer_close(peer);
+  } else {
+    peer = daemon_zalloc(sizeof(struct s_peer));
+    peer->key = strdup(key);
+    peer->loop = peers->loop;
+    peer->name = strdup(name);
+    if (peers->workers)
+      peer->strand = s_strand_new(peers->workers);
+    peer->userdata = peers->userdata;
+    s_hash_insert(peers->hash, key, peer);
+  }
+
+  _s_peer_set_addresses(peer, addresses, count);
+  ret = _s_peer_connect(peers, peer);
+
+unlock:
+  pthread_mutex_unlock(&peers->lock);
+  return ret;
+}
+
+/**
+ * @brief Remove a peer, the lock must be held
+ * @param [in] peers: manager to modify
+ * @param [in] key: service key
+ * @return 0 on success, -ENOENT if unknown
+ */
+static int _s_peers_remove(struct s_peers *peers, const char *key)
+{
+  struct s_peer *peer = s_hash_lookup(peers->hash, key);
+  if (!peer)
+    return -ENOENT;
+
+  _s_peer_close(peer);
+  _s_peer_stats_add(&peers->removed, &peer->stats);
+  return s_hash_remove(peers->hash, key);
+}
+
+struct s_peers_prune {
+  char **keys;
+  struct s_loop *loop;
+};
+
+/**
+ * @brief Collect the keys of the closed inbound peers of a loop
+ * @param [in, out] prune: NULL terminated key list, sized for every peer
+ * @param [in] key: key of the peer
+ * @param [in] peer: peer of the iteration
+ */
+static void _s_peers_closed(struct s_peers_prune *prune, const char *key,
+  struct s_peer *peer)
+{
+  /* a client is only released by the thread of its loop */
+  if (peer->inbound && peer->loop == prune->loop &&
+      peer->state == e_peer_state_closed)
+    *prune->keys++ = (char *)key;
+}
+
+/**
+ * @brief Release the closed inbound peers of a loop, their connection can
+ * not be reopened from this side. The lock must be held
+ * @param [in] peers: manager to modify
+ * @param [in] loop: loop of the peers to release
+ */
+static void _s_peers_prune(struct s_peers *peers, struct s_loop *loop)
+{
+  uint32_t count = s_hash_get_count(peers->hash);
+  if (count == 0)
+    return;
+
+  char **keys = daemon_zalloc((count + 1) * sizeof(char *));
+  struct s_peers_prune prune = { .keys = keys, .loop = loop };
+  s_hash_foreach(peers->hash, (s_hash_foreach_cbk)_s_peers_closed, &prune);
+  for (char **cursor = keys; *cursor; cursor++)
+    _s_peers_remove(peers, *cursor);
+  daemon_free(keys);
+}
+
+struct s_ssl_client *s_peers_accept(struct s_peers *peers,
+  struct s_loop *loop, const struct sockaddr_storage *address)
+{
+  daemon_return_val_if_fail(peers, NULL);
+  daemon_return_val_if_fail(loop, NULL);
+  daemon_return_val_if_fail(address, NULL);
+
+  char key[ADDRESS_STR_MAX];
+
+  if (s_address_to_string(address, key, sizeof(key)) < 0)
+    return NULL;
+
+  pthread_mutex_lock(&peers->lock);
+  _s_peers_prune(peers, loop);
+
+  /* a source port is only reused once the previous connection is closed */
+  struct s_peer *peer = s_hash_lookup(peers->hash, key);
+  if (peer && peer->loop == loop)
+    _s_peers_remove(peers, key);
+  else if (peer)
+    goto error;
+
+  peer = daemon_zalloc(sizeof(struct s_peer));
+  _s_peer_set_addresses(peer, address, 1);
+  peer->inbound = 1;
+  peer->key = strdup(key);
+  peer->loop = loop;
+  peer->name = strdup(key);
+  if (peers->workers)
+    peer->strand = s_strand_new(peers->workers);
+  peer->userdata = peers->userdata;
+  s_hash_insert(peers->hash, key, peer);
+
+  if (_s_peer_client_new(peers, peer) < 0) {
+    _s_peers_remove(peers, key);
+    goto error;
+  }
+  pthread_mutex_unlock(&peers->lock);
+  return peer->client;
+
+error:
+  pthread_mutex_unlock(&peers->lock);
+  return NULL;
+}
+
+int s_peers_remove(struct s_peers *peers, const char *key)
+{
+  daemon_return_val_if_fail(peers, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+
+  pthread_mutex_lock(&peers->lock);
+  int ret = _s_peers_remove(peers, key);
+  pthread_mutex_unlock(&peers->lock);
+  return ret;
+}
+
+int s_peers_get_state(struct s_peers *peers, const char *key)
+{
+  daemon_return_val_if_fail(peers, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+
+  int ret = -ENOENT;
+
+  pthread_mutex_lock(&peers->lock);
+  struct s_peer *peer = s_hash_lookup(peers->hash, key);
+  if (peer)
+    ret = peer->state;
+  pthread_mutex_unlock(&peers->lock);
+  return ret;
+}
+
+int s_peers_set_handshake_loops(struct s_peers *peers,
+  struct s_loop_group *group)
+{
+  daemon_return_val_if_fail(peers, -EINVAL);
+
+  pthread_mutex_lock(&peers->lock);
+  peers->handshakes = group;
+  pthread_mutex_unlock(&peers->lock);
+  return 0;
+}
+
+int s_peers_set_ktls(struct s_peers *peers, uint8_t enable)
+{
+  daemon_return_val_if_fail(peers, -EINVAL);
+
+#ifndef SSL_OP_ENABLE_KTLS
+  daemon_return_val_if_fail(!enable, -ENOTSUP);
+#endif
+  pthread_mutex_lock(&peers->lock);
+  peers->ktls = !!enable;
+  pthread_mutex_unlock(&peers->lock);
+  return 0;
+}
+
+int s_peers_set_load(struct s_peers *peers, const char *key,
+  const struct s_peer_load *load)
+{
+  daemon_return_val_if_fail(peers, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+  daemon_return_val_if_fail(load, -EINVAL);
+
+  int ret = -ENOENT;
+
+  pthread_mutex_lock(&peers->lock);
+  struct s_peer *peer = s_hash_lookup(peers->hash, key);
+  if (peer) {
+    peer->load = *load;
+    ret = 0;
+  }
+  pthread_mutex_unlock(&peers->lock);
+  return ret;
+}
+
+/**
+ * @brief Count the outbound peers connected or connecting
+ * @param [in, out] count: number of peers
+ * @param [in] key: key of the peer
+ * @param [in] peer: peer of the iteration
+ */
+static void _s_peers_outbound(uint32_t *count, daemon_unused const char *key,
+  const struct s_peer *peer)
+{
+  if (!peer->inbound && peer->state != e_peer_state_closed)
+    (*count)++;
+}
+
+uint32_t s_peers_get_outbound(struct s_peers *peers)
+{
+  daemon_return_val_if_fail(peers, 0);
+
+  uint32_t count = 0;
+
+  pthread_mutex_lock(&peers->lock);
+  s_hash_foreach(peers->hash, (s_hash_foreach_cbk)_s_peers_outbound, &count);
+  pthread_mutex_unlock(&peers->lock);
+  return count;
+}
+
+uint32_t s_peers_get_count(struct s_peers *peers)
+{
+  daemon_return_val_if_fail(peers, 0);
+
+  pthread_mutex_lock(&peers->lock);
+  uint32_t count = s_hash_get_count(peers->hash);
+  pthread_mutex_unlock(&peers->lock);
+  return count;
+}
+
+struct s_peers_foreach {
+  s_peers_foreach_cbk cbk;
+  void *userdata;
+};
+
+/**
+ * @brief Hash table iteration adapter
+ */
+static void _s_peers_foreach(struct s_peers_foreach *foreach,
+  daemon_unused const char *key, struct s_peer *peer)
+{
+  foreach->cbk(foreach->userdata, peer);
+}
+
+void s_peers_foreach(struct s_peers *peers, s_peers_foreach_cbk cbk,
+  void *userdata)
+{
+  daemon_return_if_fail(peers);
+  daemon_return_if_fail(cbk);
+
+  struct s_peers_foreach foreach = { .cbk = cbk, .userdata = userdata };
+  pthread_mutex_lock(&peers->lock);
+  s_hash_foreach(peers->hash, (s_hash_foreach_cbk)_s_peers_foreach, &foreach);
+  pthread_mutex_unlock(&peers->lock);
+}
+
+/**
+ * @brief Sample the duration of the connection which just completed into the
+ * smoothed round trip time of a peer. The lock must be held
+ * @param [in] peer: connected peer
+ */
+static void _s_peer_update_rtt(struct s_peer *peer)
+{
+  uint32_t sample = s_loop_now(peer->loop) - peer->connecting;
+
+  /* same smoothing as the tcp srtt, an eighth of the new sample */
+  peer->rtt = peer->rtt ? (7 * peer->rtt + sample) / 8 : sample;
+}
+
+struct s_peers_task {
+  struct s_peers *peers;
+  struct s_loop *loop;
+};
+
+/**
+ * @brief Release the closed inbound peers of a loop, posted to that loop
+ * @param [in] task: manager and loop to prune, freed here
+ */
+static void _s_peers_prune_task(struct s_peers_task *task)
+{
+  pthread_mutex_lock(&task->peers->lock);
+  _s_peers_prune(task->peers, task->loop);
+  pthread_mutex_unlock(&task->peers->lock);
+  daemon_free(task);
+}
+
+int s_peers_set_state(struct s_peers *peers, struct s_peer *peer,
+  enum e_peer_state state)
+{
+  daemon_return_val_if_fail(peers, -EINVAL);
+  daemon_return_val_if_fail(peer, -EINVAL);
+
+  pthread_mutex_lock(&peers->lock);
+  enum e_peer_state previous = peer->state;
+  peer->state = state;
+  if (state == e_peer_state_connected)
+    _s_peer_update_rtt(peer);
+  pthread_mutex_unlock(&peers->lock);
+
+  /* the client is still running the callback, it is released later */
+  if (peer->inbound && state == e_peer_state_closed &&
+      previous != e_peer_state_closed) {
+    struct s_peers_task *task = daemon_malloc(sizeof(struct s_peers_task));
+    task->peers = peers;
+    task->loop = peer->loop;
+    if (s_loop_post(peer->loop, (s_task_cbk)_s_peers_prune_task, task) < 0)
+      daemon_free(task);
+  }
+  return 0;
+}
+
+int s_peer_get_stats(const struct s_peer *peer, struct s_peer_stats *stats)
+{
+  daemon_return_val_if_fail(peer, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
+
+  struct s_ssl_client_stats client;
+
+  /* the loop of the peer counts its input without the lock */
+  stats->bytes_received = __atomic_load_n(&peer->stats.bytes_received,
+    __ATOMIC_RELAXED);
+  stats->bytes_sent = peer->stats.bytes_sent;
+  stats->connections = peer->stats.connections;
+  stats->errors = __atomic_load_n(&peer->stats.errors, __ATOMIC_RELAXED);
+  stats->frames_received = __atomic_load_n(&peer->stats.frames_received,
+    __ATOMIC_RELAXED);
+  stats->messages_sent = peer->stats.messages_sent;
+  if (peer->client && s_ssl_client_get_stats(peer->client, &client) == 0) {
+    stats->bytes_sent += client.bytes;
+    stats->messages_sent += client.messages;
+  }
+  return 0;
+}
+
+/**
+ * @brief Aggregate the counters of a peer
+ * @param [in, out] total: counters to increase
+ * @param [in] key: key of the peer
+ * @param [in] peer: peer to add
+ */
+static void _s_peers_stats_add(struct s_peer_stats *total,
+  daemon_unused const char *key, struct s_peer *peer)
+{
+  struct s_peer_stats stats;
+
+  if (s_peer_get_stats(peer, &stats) == 0)
+    _s_peer_stats_add(total, &stats);
+}
+
+int s_peers_get_stats(struct s_peers *peers, struct s_peer_stats *stats)
+{
+  daemon_return_val_if_fail(peers, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
+
+  pthread_mutex_lock(&peers->lock);
+  *stats = peers->removed;
+  s_hash_foreach(peers->hash, (s_hash_foreach_cbk)_s_peers_stats_add, stats);
+  pthread_mutex_unlock(&peers->lock);
+  return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DAEMON_PEERS_H_
+# define _DAEMON_PEERS_H_
+
+# include <stdint.h>
+# include <sys/socket.h>
+
+# include "daemon-group.h"
+# include "daemon-loop.h"
+# include "daemon-workers.h"
+# include "ssl/ssl.h"
+
+enum e_peer_state {
+  e_peer_state_closed,
+  e_peer_state_connected,
+  e_peer_state_connecting
+};
+
+/**
+ * @brief Traffic counters of a peer, or of all peers when aggregated
+ */
+struct s_peer_stats {
+  uint64_t bytes_received;
+  uint64_t bytes_sent;
+  uint64_t connections;
+  uint64_t errors;
+  uint64_t frames_received;
+  uint64_t messages_sent;
+};
+
+/**
+ * @brief Load advertised by a peer in its txt record
+ */
+struct s_peer_load {
+  uint32_t connections;
+  uint32_t cpu;
+  uint32_t queue;
+};
+
+/**
+ * @brief Remote cerebellum instance and its connection. The userdata of the
+ * ssl callbacks is the peer itself. @rtt is the smoothed time in
+ * milliseconds taken by the connections, handshake included. @addresses are
+ * raced when connecting, in their order. @state and @rtt are written under
+ * the lock of the manager, the input counters of @stats atomically
+ */
+struct s_peer {
+  struct sockaddr_storage *addresses;
+  uint32_t address_count;
+  struct s_ssl_client *client;
+  uint64_t connecting;
+  uint8_t inbound;
+  char *key;
+  struct s_peer_load load;
+  struct s_loop *loop;
+  char *name;
+  uint32_t rtt;
+  enum e_peer_state state;
+  struct s_peer_stats stats;
+  struct s_strand *strand;
+  void *userdata;
+};
+
+/**
+ * @brief Connection manager, owns one ssl client per discovered peer. The
+ * manager is shared by the loops of a group: the outbound peers run on the
+ * loop of the manager, the inbound ones on the loop which accepted them, and
+ * every function locks the manager. The foreach callback must not call it
+ * back
+ */
+struct s_peers;
+
+/**
+ * @brief Iteration callback
+ * @param [in] userdata: userdata given to #s_peers_foreach
+ * @param [in] peer: peer of the iteration
+ */
+typedef void (*s_peers_foreach_cbk)(void *userdata, struct s_peer *peer);
+
+/**
+ * @brief Allocate a new connection manager
+ * @param [in] loop: event loop base instance
+ * @param [in] certificate: certificate used to authenticate the connections
+ * @param [in] funcs: ssl behavior callback functions, called with the peer
+ * @param [in] workers: worker pool giving each peer a strand, NULL if none
+ * @param [in] userdata: userdata stored in each peer
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_peers *s_peers_new(struct s_loop *loop, const char *certificate,
+  const struct s_ssl_funcs *funcs, struct s_workers *workers, void *userdata);
+
+/**
+ * @brief Deallocate a specific connection manager and close every connection
+ * @param [in] peers: manager to delete
+ */
+void s_peers_free(struct s_peers *peers);
+
+/**
+ * @brief Build the key identifying a service
+ * @param [in] name: service name
+ * @param [in] type: service type
+ * @param [in] domain: service domain
+ * @return a valid pointer to free with #daemon_free on success, NULL on error
+ */
+char *s_peers_key(const char *name, const char *type, const char *domain);
+
+/**
+ * @brief Add a peer and connect to it. A peer already known is not connected
+ * twice, it is only reconnected if its connection is closed, its addresses
+ * are updated for the next connection anyway
+ * @param [in] peers: manager to modify
+ * @param [in] key: service key, see #s_peers_key
+ * @param [in] name: service name
+ * @param [in] addresses: addresses of the service in preference order, see
+ * #s_address_interleave
+ * @param [in] count: number of addresses
+ * @return 0 on success, -EALREADY if the peer is already connected, an -errno
+ * value on error
+ */
+int s_peers_add(struct s_peers *peers, const char *key, const char *name,
+  const struct sockaddr_storage *addresses, uint32_t count);
+
+/**
+ * @brief Register an inbound connection, the peer is keyed by its address.
+ * Matches #s_ssl_accept_cbk, a closed inbound peer is released on its loop,
+ * see #s_peers_set_state
+ * @param [in] peers: manager to modify
+ * @param [in] loop: loop of the accepting thread, the client runs on it
+ * @param [in] address: address of the remote peer
+ * @return a client to attach the accepted socket to on success, NULL on error
+ */
+struct s_ssl_client *s_peers_accept(struct s_peers *peers,
+  struct s_loop *loop, const struct sockaddr_storage *address);
+
+/**
+ * @brief Remove a peer and close its connection
+ * @param [in] peers: manager to modify
+ * @param [in] key: service key, see #s_peers_key
+ * @return 0 on success, -ENOENT if unknown, an -errno value on error
+ */
+int s_peers_remove(struct s_peers *peers, const char *key);
+
+/**
+ * @brief Get the connection state of a peer, read under the lock since the
+ * peer may be released meanwhile
+ * @param [in] peers: manager to browse
+ * @param [in] key: service key, see #s_peers_key
+ * @return the state on success, -ENOENT if unknown, an -errno value on error
+ */
+int s_peers_get_state(struct s_peers *peers, const char *key);
+
+/**
+ * @brief Perform the handshakes of the peers connected from now on the loops
+ * of a group, spread in turn, see #s_ssl_client_set_handshake_loop
+ * @param [in] peers: manager to modify
+ * @param [in] group: running handshake loops, NULL to handshake on the loops
+ * of the peers
+ * @return 0 on success, an -errno value on error
+ */
+int s_peers_set_handshake_loops(struct s_peers *peers,
+  struct s_loop_group *group);
+
+/**
+ * @brief Let the kernel encrypt the records of the peers connected from now,
+ * see #s_ssl_client_set_ktls
+ * @param [in] peers: manager to modify
+ * @param [in] enable: 1 to enable, 0 to disable
+ * @return 0 on success, -ENOTSUP if the ssl library lacks kTLS, an -errno
+ * value on error
+ */
+int s_peers_set_ktls(struct s_peers *peers, uint8_t enable);
+
+/**
+ * @brief Update the load advertised by a peer
+ * @param [in] peers: manager to modify
+ * @param [in] key: service key, see #s_peers_key
+ * @param [in] load: advertised load
+ * @return 0 on success, -ENOENT if unknown, an -errno value on error
+ */
+int s_peers_set_load(struct s_peers *peers, const char *key,
+  const struct s_peer_load *load);
+
+/**
+ * @brief Get the number of peers
+ * @param [in] peers: manager to browse
+ * @return the number of peers
+ */
+uint32_t s_peers_get_count(struct s_peers *peers);
+
+/**
+ * @brief Get the number of outbound peers connected or connecting
+ * @param [in] peers: manager to browse
+ * @return the number of peers
+ */
+uint32_t s_peers_get_outbound(struct s_peers *peers);
+
+/**
+ * @brief Call a function on every peer
+ * @param [in] peers: manager to browse
+ * @param [in] cbk: function to call
+ * @param [in] userdata: userdata given to @cbk
+ */
+void s_peers_foreach(struct s_peers *peers, s_peers_foreach_cbk cbk,
+  void *userdata);
+
+/**
+ * @brief Publish the connection state of a peer, from the loop of the peer.
+ * A connected peer samples its round trip time, a closed inbound peer is
+ * released by a task posted to its loop
+ * @param [in] peers: manager of the peer
+ * @param [in] peer: peer to modify
+ * @param [in] state: new connection state
+ * @return 0 on success, an -errno value on error
+ */
+int s_peers_set_state(struct s_peers *peers, struct s_peer *peer,
+  enum e_peer_state state);
+
+/**
+ * @brief Get the counters of a peer
+ * @param [in] peer: peer to browse
+ * @param [out] stats: counters to fill
+ * @return 0 on success, an -errno value on error
+ */
+int s_peer_get_stats(const struct s_peer *peer, struct s_peer_stats *stats);
+
+/**
+ * @brief Get the counters aggregated over every peer, removed ones included
+ * @param [in] peers: manager to browse
+ * @param [out] stats: counters to fill
+ * @return 0 on success, an -errno value on error
+ */
+int s_peers_get_stats(struct s_peers *peers, struct s_peer_stats *stats);
+
+#endif /* !_DAEMON_PEERS_H_ */
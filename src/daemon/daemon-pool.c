@@ -0,0 +1,178 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libdaemon/dlog.h>
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-pool.h"
+
+/**
+ * @brief Smallest size class, the next ones are the following powers of two
+ */
+#define POOL_CLASS_MIN_SHIFT 6
+
+/**
+ * @brief Number of size classes, from 64 bytes to 16 kilobytes
+ */
+#define POOL_CLASS_COUNT 9
+
+/**
+ * @brief Maximum number of blocks kept in a free list
+ */
+#define POOL_CLASS_DEPTH 128
+
+/**
+ * @brief Class index used for the blocks bigger than the biggest class
+ */
+#define POOL_CLASS_NONE POOL_CLASS_COUNT
+
+/**
+ * @brief Header stored in front of each block, two words long so the payload
+ * keeps the alignment given by the system allocator
+ */
+struct s_pool_block {
+  struct s_pool_block *next;
+  uint64_t index;
+};
+
+struct s_pool_class {
+  struct s_pool_block *blocks;
+  uint32_t count;
+};
+
+struct s_pool {
+  struct s_pool_class classes[POOL_CLASS_COUNT];
+  struct s_pool_stats stats;
+};
+
+static __thread struct s_pool *_g_pool_current;
+
+/**
+ * @brief Get the size class able to hold a specific size
+ * @param [in] size: size requested by the user
+ * @return a class index, POOL_CLASS_NONE if the size is too big
+ */
+static uint32_t _s_pool_class_index(size_t size)
+{
+  uint32_t index = 0;
+
+  while (index < POOL_CLASS_COUNT &&
+         ((size_t)1 << (index + POOL_CLASS_MIN_SHIFT)) < size)
+    index++;
+  return index;
+}
+
+/**
+ * @brief Allocate a block from the system allocator
+ * @param [in] size: payload size
+ * @return a valid pointer
+ */
+static struct s_pool_block *_s_pool_block_new(size_t size)
+{
+  return daemon_malloc(sizeof(struct s_pool_block) + size);
+}
+
+struct s_pool *s_pool_new(void)
+{
+  return daemon_zalloc(sizeof(struct s_pool));
+}
+
+void s_pool_free(struct s_pool *pool)
+{
+  daemon_return_if_fail(pool);
+
+  if (_g_pool_current == pool)
+    _g_pool_current = NULL;
+
+  for (uint32_t i = 0; i < POOL_CLASS_COUNT; ++i) {
+    struct s_pool_block *block = pool->classes[i].blocks;
+    while (block) {
+      struct s_pool_block *next = block->next;
+      daemon_free(block);
+      block = next;
+    }
+  }
+  daemon_free(pool);
+}
+
+int s_pool_get_stats(const struct s_pool *pool, struct s_pool_stats *stats)
+{
+  daemon_return_val_if_fail(pool, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
+
+  *stats = pool->stats;
+  return 0;
+}
+
+void s_pool_set_current(struct s_pool *pool)
+{
+  _g_pool_current = pool;
+}
+
+struct s_pool *s_pool_get_current(void)
+{
+  return _g_pool_current;
+}
+
+void *daemon_pool_alloc(size_t size)
+{
+  struct s_pool *pool = _g_pool_current;
+  uint32_t index = _s_pool_class_index(size);
+  struct s_pool_block *block = NULL;
+
+  if (index == POOL_CLASS_NONE) {
+    block = _s_pool_block_new(size);
+    if (pool)
+      pool->stats.large++;
+  } else if (pool && pool->classes[index].blocks) {
+    struct s_pool_class *class = &pool->classes[index];
+    block = class->blocks;
+    class->blocks = block->next;
+    class->count--;
+    pool->stats.hits++;
+  } else {
+    /* always allocate the full class size so the block can be recycled */
+    block = _s_pool_block_new((size_t)1 << (index + POOL_CLASS_MIN_SHIFT));
+    if (pool)
+      pool->stats.misses++;
+  }
+
+  block->index = index;
+  return block + 1;
+}
+
+void daemon_pool_free(void *ptr)
+{
+  daemon_return_if_fail(ptr);
+
+  struct s_pool *pool = _g_pool_current;
+  struct s_pool_block *block = (struct s_pool_block *)ptr - 1;
+  uint32_t index = (uint32_t)block->index;
+
+  if (index == POOL_CLASS_NONE || !pool) {
+    daemon_free(block);
+  } else if (pool->classes[index].count >= POOL_CLASS_DEPTH) {
+    daemon_free(block);
+    pool->stats.drops++;
+  } else {
+    struct s_pool_class *class = &pool->classes[index];
+    block->next = class->blocks;
+    class->blocks = block;
+    class->count++;
+    pool->stats.releases++;
+  }
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DAEMON_POOL_H_
+# define _DAEMON_POOL_H_
+
+# include <stddef.h>
+# include <stdint.h>
+
+/**
+ * @brief Size-classed free-list allocator. A pool is only used by the thread
+ * that installed it with #s_pool_set_current, so no locking is involved
+ */
+struct s_pool;
+
+/**
+ * @brief Pool usage counters
+ */
+struct s_pool_stats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t large;
+  uint64_t releases;
+  uint64_t drops;
+};
+
+/**
+ * @brief Allocate a new pool
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_pool *s_pool_new(void);
+
+/**
+ * @brief Deallocate a specific pool and every block kept in its free lists
+ * @param [in] pool: pool to delete
+ */
+void s_pool_free(struct s_pool *pool);
+
+/**
+ * @brief Get the usage counters of a pool
+ * @param [in] pool: pool to browse
+ * @param [out] stats: counters to fill
+ * @return 0 on success, an -errno value on error
+ */
+int s_pool_get_stats(const struct s_pool *pool, struct s_pool_stats *stats);
+
+/**
+ * @brief Install the pool used by #daemon_pool_alloc and #daemon_pool_free on
+ * the calling thread
+ * @param [in] pool: pool to install, NULL to fall back on the system allocator
+ */
+void s_pool_set_current(struct s_pool *pool);
+
+/**
+ * @brief Get the pool installed on the calling thread
+ * @return a valid pointer if a pool is installed, NULL otherwise
+ */
+struct s_pool *s_pool_get_current(void);
+
+/**
+ * @brief Allocate a block from the pool of the calling thread. The memory is
+ * not initialized. A block can be released from any thread, it then goes back
+ * to the pool of the releasing thread
+ * @param [in] size: size bytes to allocate
+ * @return a valid pointer
+ */
+void *daemon_pool_alloc(size_t size);
+
+/**
+ * @brief Release a block allocated with #daemon_pool_alloc
+ * @param [in] ptr: pointer to release
+ */
+void daemon_pool_free(void *ptr);
+
+#endif /* !_DAEMON_POOL_H_ */
@@ -0,0 +1,254 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <event2/event.h>
+#include <libdaemon/dlog.h>
+#include <unistd.h>
+#include "daemon-address.h"
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-race.h"
+#include "daemon-timer.h"
+
+/**
+ * @brief Connection attempt on one address, @fd is -1 when not running
+ */
+struct s_race_attempt {
+  struct event *event;
+  evutil_socket_t fd;
+  uint32_t index;
+  struct s_race *race;
+};
+
+struct s_race {
+  struct sockaddr_storage *addresses;
+  struct s_race_attempt *attempts;
+  s_race_cbk cbk;
+  uint32_t count;
+  struct s_timer *delay;
+  int error;
+  struct s_loop *loop;
+  uint32_t next;
+  uint32_t running;
+  struct s_timer *timeout;
+  void *userdata;
+};
+
+/**
+ * @brief Stop an attempt and close its socket
+ * @param [in] attempt: attempt to stop
+ */
+static void _s_race_attempt_stop(struct s_race_attempt *attempt)
+{
+  if (attempt->fd < 0)
+    return;
+
+  event_free(attempt->event);
+  attempt->event = NULL;
+  evutil_closesocket(attempt->fd);
+  attempt->fd = -1;
+  attempt->race->running--;
+}
+
+/**
+ * @brief Stop every attempt and the timers of a race
+ * @param [in] race: race to stop
+ */
+static void _s_race_stop(struct s_race *race)
+{
+  for (uint32_t i = 0; i < race->count; ++i)
+    _s_race_attempt_stop(&race->attempts[i]);
+  s_timer_cancel(race->delay);
+  s_timer_cancel(race->timeout);
+}
+
+/**
+ * @brief End a race without winner
+ * @param [in] race: race to end
+ * @param [in] error: an -errno value
+ */
+static void _s_race_lost(struct s_race *race, int error)
+{
+  _s_race_stop(race);
+  daemon_log(LOG_INFO, "%u addresses tried, no connection '%s'\n",
+    race->count, strerror(-error));
+  race->cbk(race->userdata, -1, NULL, error);
+}
+
+/**
+ * @brief End a race with the first connected attempt, its socket is handed
+ * over to the callback
+ * @param [in] attempt: connected attempt
+ */
+static void _s_race_won(struct s_race_attempt *attempt)
+{
+  struct s_race *race = attempt->race;
+  evutil_socket_t fd = attempt->fd;
+
+  /* the socket leaves the race, the other attempts are closed */
+  event_free(attempt->event);
+  attempt->event = NULL;
+  attempt->fd = -1;
+  race->running--;
+  _s_race_stop(race);
+  race->cbk(race->userdata, fd, &race->addresses[attempt->index], 0);
+}
+
+static void _s_race_attempt_cbk(evutil_socket_t fd, short e,
+  struct s_race_attempt *attempt);
+
+/**
+ * @brief Start the attempts of the next addresses until one is running
+ * @param [in] race: race to continue
+ * @return 0 if an attempt started, an -errno value if no address is left
+ */
+static int _s_race_next(struct s_race *race)
+{
+  s_timer_cancel(race->delay);
+  while (race->next < race->count) {
+    struct s_race_attempt *attempt = &race->attempts[race->next];
+    const struct sockaddr_storage *address = &race->addresses[race->next++];
+
+    attempt->fd = socket(address->ss_family, SOCK_STREAM | SOCK_NONBLOCK |
+      SOCK_CLOEXEC, 0);
+    if (attempt->fd < 0) {
+      /* no route or no stack for the family, try the next one at once */
+      race->error = -errno;
+      continue;
+    }
+    if (connect(attempt->fd, (const struct sockaddr *)address,
+        s_address_get_size(address)) < 0 && errno != EINPROGRESS) {
+      race->error = -errno;
+      evutil_closesocket(attempt->fd);
+      attempt->fd = -1;
+      continue;
+    }
+
+    attempt->event = event_new(s_loop_tolibevent(race->loop), attempt->fd,
+      EV_WRITE, (event_callback_fn)_s_race_attempt_cbk, attempt);
+    event_add(attempt->event, NULL);
+    race->running++;
+    if (race->next < race->count)
+      s_timer_arm(race->delay, RACE_ATTEMPT_DELAY);
+    return 0;
+  }
+  return race->error;
+}
+
+/**
+ * @brief Write event of an attempt, raised once its connection completed or
+ * failed
+ * @param [in] fd: socket of the attempt
+ * @param [in] e: event received
+ * @param [in] attempt: attempt of the socket
+ */
+static void _s_race_attempt_cbk(evutil_socket_t fd, daemon_unused short e,
+  struct s_race_attempt *attempt)
+{
+  struct s_race *race = attempt->race;
+  socklen_t size = sizeof(int);
+  int error = 0;
+
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) < 0)
+    error = errno;
+  if (!error) {
+    _s_race_won(attempt);
+    return;
+  }
+
+  race->error = -error;
+  _s_race_attempt_stop(attempt);
+  /* a failed attempt does not wait for the delay of the next one */
+  if (_s_race_next(race) < 0 && !race->running)
+    _s_race_lost(race, race->error);
+}
+
+/**
+ * @brief Delay timer, the running attempts are slow: start the next one
+ * @param [in] timer: delay timer
+ * @param [in] race: race to continue
+ */
+static void _s_race_delay_cbk(daemon_unused struct s_timer *timer,
+  struct s_race *race)
+{
+  if (_s_race_next(race) < 0 && !race->running)
+    _s_race_lost(race, race->error);
+}
+
+/**
+ * @brief Timeout timer, gives up the running attempts
+ * @param [in] timer: timeout timer
+ * @param [in] race: race to end
+ */
+static void _s_race_timeout_cbk(daemon_unused struct s_timer *timer,
+  struct s_race *race)
+{
+  _s_race_lost(race, -ETIMEDOUT);
+}
+
+struct s_race *s_race_new(struct s_loop *loop,
+  const struct sockaddr_storage *addresses, uint32_t count, s_race_cbk cbk,
+  void *userdata)
+{
+  daemon_return_val_if_fail(loop, NULL);
+  daemon_return_val_if_fail(addresses, NULL);
+  daemon_return_val_if_fail(count > 0, NULL);
+  daemon_return_val_if_fail(cbk, NULL);
+
+  struct s_race *race = daemon_zalloc(sizeof(struct s_race));
+  race->addresses = daemon_malloc(count * sizeof(struct sockaddr_storage));
+  memcpy(race->addresses, addresses, count * sizeof(*addresses));
+  race->attempts = daemon_calloc(count, sizeof(struct s_race_attempt));
+  for (uint32_t i = 0; i < count; ++i) {
+    race->attempts[i].fd = -1;
+    race->attempts[i].index = i;
+    race->attempts[i].race = race;
+  }
+  race->cbk = cbk;
+  race->count = count;
+  race->delay = s_timer_new(loop, (s_timer_cbk)_s_race_delay_cbk, race);
+  race->error = -EHOSTUNREACH;
+  race->loop = loop;
+  race->timeout = s_timer_new(loop, (s_timer_cbk)_s_race_timeout_cbk, race);
+  race->userdata = userdata;
+
+  int ret = -ENOMEM;
+  if (race->delay && race->timeout)
+    ret = _s_race_next(race);
+  if (ret < 0) {
+    s_race_free(race);
+    errno = -ret;
+    return NULL;
+  }
+  s_timer_arm(race->timeout, RACE_TIMEOUT);
+  return race;
+}
+
+void s_race_free(struct s_race *race)
+{
+  daemon_return_if_fail(race);
+
+  for (uint32_t i = 0; i < race->count; ++i)
+    _s_race_attempt_stop(&race->attempts[i]);
+  if (race->delay)
+    s_timer_free(race->delay);
+  if (race->timeout)
+    s_timer_free(race->timeout);
+  daemon_free(race->attempts);
+  daemon_free(race->addresses);
+  daemon_free(race);
+}
@@ -0,0 +1,78 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DAEMON_RACE_H_
+# define _DAEMON_RACE_H_
+
+# include <event2/util.h>
+# include <stdint.h>
+# include <sys/socket.h>
+
+# include "daemon-loop.h"
+
+/**
+ * @brief Delay in milliseconds before the next address is tried while the
+ * previous attempts are still running, the Connection Attempt Delay of
+ * RFC 8305
+ */
+# define RACE_ATTEMPT_DELAY 250
+
+/**
+ * @brief Timeout in milliseconds of a whole race
+ */
+# define RACE_TIMEOUT 10000
+
+/**
+ * @brief Connection race over several addresses of a peer (Happy Eyeballs,
+ * RFC 8305): the attempts start in the order of the addresses, staggered by
+ * #RACE_ATTEMPT_DELAY, a failed attempt starts the next one at once, and the
+ * first connected socket wins
+ */
+struct s_race;
+
+/**
+ * @brief Completion callback of a race, called once. The race can be freed
+ * from it
+ * @param [in] userdata: userdata given to #s_race_new
+ * @param [in] fd: connected socket owned by the callee, -1 if every attempt
+ * failed
+ * @param [in] address: address of @fd, NULL if every attempt failed
+ * @param [in] error: 0 on success, an -errno value on error
+ */
+typedef void (*s_race_cbk)(void *userdata, evutil_socket_t fd,
+  const struct sockaddr_storage *address, int error);
+
+/**
+ * @brief Allocate a race and start its first attempt
+ * @param [in] loop: loop running the attempts
+ * @param [in] addresses: addresses to try in order, see #s_address_interleave
+ * @param [in] count: number of addresses
+ * @param [in] cbk: completion callback
+ * @param [in] userdata: userdata given to @cbk
+ * @return a valid pointer on success, NULL with errno set on error
+ */
+struct s_race *s_race_new(struct s_loop *loop,
+  const struct sockaddr_storage *addresses, uint32_t count, s_race_cbk cbk,
+  void *userdata);
+
+/**
+ * @brief Deallocate a race, its running attempts are closed
+ * @param [in] race: race to delete
+ */
+void s_race_free(struct s_race *race);
+
+#endif /* !_DAEMON_RACE_H_ */
@@ -0,0 +1,158 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libdaemon/dlog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-ctx.h"
+#include "daemon-peers.h"
+#include "daemon-timer.h"
+#include "daemon-workers.h"
+#include "avahi/avahi-group.h"
+#include "avahi/avahi-service.h"
+
+/**
+ * @brief Delay in milliseconds between two samples of the load, the group
+ * rate limits the resulting txt record updates
+ */
+#define DAEMON_LOAD_INTERVAL 1000
+
+/**
+ * @brief Granularity of the published cpu usage, in percent, so a steady
+ * load does not trigger updates
+ */
+#define DAEMON_LOAD_CPU_STEP 5
+
+/**
+ * @brief Call when the service is registered on the network
+ * @param [in] ctx: userdata passing through the allocation
+ * @param [in] name: name of the service
+ */
+static void _s_daemon_ctx_service_established(struct s_daemon_ctx *ctx,
+  const char *name)
+{
+  daemon_return_if_fail(ctx);
+
+  daemon_log(LOG_NOTICE, "cerebellum '%s' published\n", name);
+}
+
+/**
+ * @brief Call when an error occured.
+ * @param [in] ctx: userdata passing through the allocation
+ * @param [in] error: the avahi error value
+ */
+static void _s_daemon_ctx_service_failure(struct s_daemon_ctx *ctx,
+  int error)
+{
+  daemon_return_if_fail(ctx);
+
+  daemon_log(LOG_ERR, "cerebellum service failed '%d'\n", error);
+}
+
+/**
+ * @brief Get the cpu usage of the host, from the load average over a minute
+ * @return the usage in percent, rounded down to #DAEMON_LOAD_CPU_STEP
+ */
+static uint32_t _s_daemon_ctx_cpu(void)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  double load;
+
+  if (cores <= 0 || getloadavg(&load, 1) != 1)
+    return 0;
+
+  uint32_t usage = (uint32_t)(load * 100 / cores);
+  return usage - usage % DAEMON_LOAD_CPU_STEP;
+}
+
+/**
+ * @brief Set a numeric key of the txt record
+ * @param [in] group: group to modify
+ * @param [in] key: key to set
+ * @param [in] value: value of the key
+ */
+static void _s_daemon_ctx_load_set(struct s_group *group, const char *key,
+  uint32_t value)
+{
+  char str[16];
+
+  snprintf(str, sizeof(str), "%u", value);
+  s_group_set_txt(group, key, str);
+}
+
+/**
+ * @brief Timer callback, sample the load and publish it
+ * @param [in] timer: expired timer
+ * @param [in] ctx: daemon context
+ */
+static void _s_daemon_ctx_load(struct s_timer *timer, struct s_daemon_ctx *ctx)
+{
+  daemon_return_if_fail(ctx);
+
+  _s_daemon_ctx_load_set(ctx->service, SERVICE_LOAD_CONNECTIONS,
+    s_peers_get_count(ctx->peers));
+  _s_daemon_ctx_load_set(ctx->service, SERVICE_LOAD_CPU, _s_daemon_ctx_cpu());
+  _s_daemon_ctx_load_set(ctx->service, SERVICE_LOAD_QUEUE,
+    s_workers_get_pending(ctx->workers));
+  s_timer_arm(timer, DAEMON_LOAD_INTERVAL);
+}
+
+/**
+ * @brief Get the group behavior function
+ * @return a valid pointer on success
+ */
+static const struct s_group_funcs *_s_daemon_ctx_group_get_funcs(void)
+{
+  static const struct s_group_funcs funcs = {
+    .established = (s_group_established_cbk)_s_daemon_ctx_service_established,
+    .failure = (s_group_failure_cbk)_s_daemon_ctx_service_failure,
+  };
+  return &funcs;
+}
+
+int s_daemon_ctx_publish(struct s_daemon_ctx *ctx)
+{
+  daemon_return_val_if_fail(ctx, -EINVAL);
+
+  /* created first, so a later call retries whatever failed */
+  if (!ctx->load) {
+    ctx->load = s_timer_new(ctx->loop, (s_timer_cbk)_s_daemon_ctx_load, ctx);
+    if (!ctx->load)
+      return -ENOMEM;
+  }
+
+  if (!ctx->service) {
+    ctx->service = s_group_new(ctx->client, ctx->loop, s_service_generate(),
+      _s_daemon_ctx_group_get_funcs(), ctx);
+    if (!ctx->service)
+      return -EBADE;
+    /* sampled first, the initial announcement carries the load */
+    _s_daemon_ctx_load(ctx->load, ctx);
+  }
+  return s_group_publish(ctx->service);
+}
+
+int s_daemon_ctx_withdraw(struct s_daemon_ctx *ctx)
+{
+  daemon_return_val_if_fail(ctx, -EINVAL);
+
+  return ctx->service ? s_group_reset(ctx->service) : 0;
+}
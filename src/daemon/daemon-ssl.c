@@ -15,32 +15,62 @@
  * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <libdaemon/dlog.h>
 
 #include "daemon-alloc.h"
 #include "daemon-cond.h"
 #include "daemon-ctx.h"
+#include "daemon-peers.h"
+#include "daemon-pool.h"
 #include "ssl/ssl.h"
+#include "ssl/ssl-client.h"
+
+/**
+ * @brief Congestion status callback
+ * @param [in] peer: peer owning the connection
+ * @param [in] state: current congestion status
+ */
+static void _s_daemon_ctx_ssl_congestion(struct s_peer *peer,
+  enum e_ssl_congestion state)
+{
+  daemon_return_if_fail(peer);
+
+  switch (state) {
+  case e_ssl_congestion_congested:
+    daemon_log(LOG_NOTICE, "ssl connection to '%s' congested\n", peer->name);
+    break;
+  case e_ssl_congestion_writable:
+    daemon_log(LOG_NOTICE, "ssl connection to '%s' writable\n", peer->name);
+    break;
+  }
+}
 
 /**
  * @brief Connection status callback
- * @param [in] ctx: userdata passing through the allocation
+ * @param [in] peer: peer owning the connection
  * @param [in] state: current connection status
  */
-static void _s_daemon_ctx_ssl_connection(struct s_daemon_ctx *ctx,
+static void _s_daemon_ctx_ssl_connection(struct s_peer *peer,
   enum e_ssl_connection state)
 {
-  daemon_return_if_fail(ctx);
+  daemon_return_if_fail(peer);
+
+  struct s_daemon_ctx *ctx = peer->userdata;
 
   switch (state) {
   case e_ssl_connection_close:
-    daemon_log(LOG_NOTICE, "ssl connection closed\n");
+    daemon_log(LOG_NOTICE, "ssl connection to '%s' closed\n", peer->name);
+    s_peers_set_state(ctx->peers, peer, e_peer_state_closed);
     break;
   case e_ssl_connection_connected:
-    daemon_log(LOG_NOTICE, "ssl connection connected\n");
+    daemon_log(LOG_NOTICE, "ssl connection to '%s' connected%s\n", peer->name,
+      s_ssl_client_is_ktls(peer->client) == 1 ? " (kernel TLS)" : "");
+    s_peers_set_state(ctx->peers, peer, e_peer_state_connected);
     break;
   case e_ssl_connection_timeout:
-    daemon_log(LOG_NOTICE, "ssl connection timeout\n");
+    daemon_log(LOG_NOTICE, "ssl connection to '%s' timeout\n", peer->name);
+    s_peers_set_state(ctx->peers, peer, e_peer_state_closed);
     break;
   }
 }
@@ -48,28 +78,34 @@ static void _s_daemon_ctx_ssl_connection(struct s_daemon_ctx *ctx,
 /**
  * @brief Error status callback, called whenever a read / write operation
  * failed
- * @param [in] ctx: userdata passing through the allocation
+ * @param [in] peer: peer owning the connection
  * @param [in] type: error type definition
  * @param [in] packet: payload to send
  * @param [in] error: error received from ssl
  */
-static void _s_daemon_ctx_ssl_error(struct s_daemon_ctx *ctx,
+static void _s_daemon_ctx_ssl_error(struct s_peer *peer,
   enum e_ssl_error type, daemon_unused int error,
   const struct s_ssl_packet *packet)
 {
-  daemon_return_if_fail(ctx);
+  daemon_return_if_fail(peer);
+
+  struct s_daemon_ctx *ctx = peer->userdata;
 
   switch (type) {
   case e_ssl_error_connection:
-    daemon_log(LOG_ERR, "failed ssl connection\n");
-    s_daemon_ctx_quit(ctx);
+    /* the peer stays known, it is reconnected on its next announce */
+    daemon_log(LOG_ERR, "failed ssl connection to '%s'\n", peer->name);
+    __atomic_add_fetch(&peer->stats.errors, 1, __ATOMIC_RELAXED);
+    s_peers_set_state(ctx->peers, peer, e_peer_state_closed);
     break;
   case e_ssl_error_read:
     daemon_log(LOG_ERR, "failed ssl read\n");
+    __atomic_add_fetch(&peer->stats.errors, 1, __ATOMIC_RELAXED);
     daemon_return_if_fail(packet);
     break;
   case e_ssl_error_write:
     daemon_log(LOG_ERR, "failed ssl write\n");
+    __atomic_add_fetch(&peer->stats.errors, 1, __ATOMIC_RELAXED);
     daemon_return_if_fail(packet);
     break;
   default:
@@ -79,25 +115,86 @@ static void _s_daemon_ctx_ssl_error(struct s_daemon_ctx *ctx,
 }
 
 /**
- * @brief Read callback, called whenever a packet is received
- * @param [in] ctx: userdata passing through the allocation
- * @param [in] packet: payload received
+ * @brief Received frame handed to the workers, the payload and the name of
+ * the peer are copied after the job so that the peer may go away meanwhile
  */
-static void _s_daemon_ctx_ssl_read(struct s_daemon_ctx *ctx,
-  const struct s_ssl_packet *packet)
+struct s_daemon_ctx_job {
+  struct s_ssl_frame frame;
+  const char *name;
+  uint8_t payload[];
+};
+
+/**
+ * @brief Application processing of a frame, runs on a worker
+ * @param [in] job: frame to process
+ */
+static void _s_daemon_ctx_ssl_process(struct s_daemon_ctx_job *job)
+{
+  daemon_log(LOG_DEBUG, "frame of type %u received from '%s' (%u bytes)\n",
+    job->frame.type, job->name, job->frame.size);
+}
+
+/**
+ * @brief Completion of a frame processing, runs back on the loop of the peer
+ * @param [in] job: processed frame
+ */
+static void _s_daemon_ctx_ssl_processed(struct s_daemon_ctx_job *job)
+{
+  daemon_pool_free(job);
+}
+
+/**
+ * @brief Frame callback, called whenever a complete frame is received. The
+ * frame is processed by the workers, in order on the strand of the peer
+ * @param [in] peer: peer owning the connection
+ * @param [in] frame: frame received
+ */
+static void _s_daemon_ctx_ssl_frame(struct s_peer *peer,
+  const struct s_ssl_frame *frame)
+{
+  daemon_return_if_fail(peer);
+  daemon_return_if_fail(frame);
+
+  __atomic_add_fetch(&peer->stats.bytes_received,
+    SSL_FRAME_HEADER_SIZE + frame->size, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&peer->stats.frames_received, 1, __ATOMIC_RELAXED);
+
+  size_t length = strlen(peer->name) + 1;
+  struct s_daemon_ctx_job *job = daemon_pool_alloc(
+    sizeof(struct s_daemon_ctx_job) + frame->size + length);
+  job->frame = *frame;
+  job->frame.payload = job->payload;
+  if (frame->size)
+    memcpy(job->payload, frame->payload, frame->size);
+  job->name = memcpy(job->payload + frame->size, peer->name, length);
+
+  if (!peer->strand || s_strand_submit(peer->strand,
+      (s_work_cbk)_s_daemon_ctx_ssl_process, peer->loop,
+      (s_task_cbk)_s_daemon_ctx_ssl_processed, job) < 0) {
+    _s_daemon_ctx_ssl_process(job);
+    _s_daemon_ctx_ssl_processed(job);
+  }
+}
+
+int s_daemon_ctx_send(struct s_daemon_ctx *ctx,
+  const struct s_ssl_frame *frame)
 {
-  daemon_return_if_fail(ctx);
-  daemon_return_if_fail(packet);
+  daemon_return_val_if_fail(ctx, -EINVAL);
+  daemon_return_val_if_fail(frame, -EINVAL);
 
-  daemon_log(LOG_NOTICE, "a packet is received");
+  struct s_peer *peer = s_balancer_pick(ctx->balancer);
+  if (!peer)
+    return -EAGAIN;
+  return s_ssl_client_write_frame(peer->client, frame);
 }
 
 const struct s_ssl_funcs *s_daemon_ctx_ssl_get_funcs(void)
 {
   static const struct s_ssl_funcs funcs = {
+    .congestion = (s_ssl_congestion_cbk)_s_daemon_ctx_ssl_congestion,
     .connection = (s_ssl_connection_cbk)_s_daemon_ctx_ssl_connection,
     .error = (s_ssl_error_cbk)_s_daemon_ctx_ssl_error,
-    .read = (s_ssl_read_cbk)_s_daemon_ctx_ssl_read,
+    .frame = (s_ssl_frame_cbk)_s_daemon_ctx_ssl_frame,
   };
   return &funcs;
 }
@@ -0,0 +1,277 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libdaemon/dlog.h>
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-timer.h"
+
+/**
+ * @brief Number of slots of the wheel, a power of 2. With a 1 ms tick the
+ * wheel turns every 4 s, the longer timers stay in their slot for some turns
+ */
+#define TIMER_WHEEL_SLOTS 4096
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_NONE UINT64_MAX
+
+struct s_timer {
+  s_timer_cbk cbk;
+  uint64_t expires;
+  struct s_timer **list;
+  struct s_timer *next;
+  struct s_timer *prev;
+  void *userdata;
+  struct s_timer_wheel *wheel;
+};
+
+struct s_timer_wheel {
+  uint64_t bitmap[TIMER_WHEEL_SLOTS / 64];
+  uint64_t current;
+  struct event *event;
+  struct s_timer *expired;
+  struct s_loop *loop;
+  uint64_t scheduled;
+  struct s_timer *slots[TIMER_WHEEL_SLOTS];
+  struct s_timer_stats stats;
+};
+
+/**
+ * @brief Insert a timer at the head of a list, a slot or the expired ones
+ * @param [in] list: list to modify
+ * @param [in] timer: timer to insert
+ */
+static void _s_timer_link(struct s_timer **list, struct s_timer *timer)
+{
+  timer->list = list;
+  timer->prev = NULL;
+  timer->next = *list;
+  if (*list)
+    (*list)->prev = timer;
+  *list = timer;
+}
+
+/**
+ * @brief Remove a timer from its list, clearing the slot bit once empty
+ * @param [in] timer: timer to remove
+ */
+static void _s_timer_unlink(struct s_timer *timer)
+{
+  struct s_timer_wheel *wheel = timer->wheel;
+
+  if (timer->prev)
+    timer->prev->next = timer->next;
+  else
+    *timer->list = timer->next;
+  if (timer->next)
+    timer->next->prev = timer->prev;
+
+  if (timer->list != &wheel->expired && !*timer->list) {
+    uint32_t slot = timer->list - wheel->slots;
+
+    wheel->bitmap[slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+  }
+  timer->list = NULL;
+  timer->next = NULL;
+  timer->prev = NULL;
+}
+
+/**
+ * @brief Make sure the kernel timer wakes the loop up by a tick
+ * @param [in] wheel: wheel to schedule
+ * @param [in] tick: tick to reach
+ */
+static void _s_timer_wheel_schedule(struct s_timer_wheel *wheel,
+  uint64_t tick)
+{
+  if (tick >= wheel->scheduled)
+    return;
+
+  uint64_t now = s_loop_now(wheel->loop);
+  uint64_t delay = tick > now ? tick - now : 0;
+  struct timeval tv = { delay / 1000, (delay % 1000) * 1000 };
+
+  if (event_add(wheel->event, &tv) == 0)
+    wheel->scheduled = tick;
+}
+
+/**
+ * @brief Schedule the kernel timer on the nearest slot holding timers
+ * @param [in] wheel: wheel to schedule
+ */
+static void _s_timer_wheel_schedule_next(struct s_timer_wheel *wheel)
+{
+  uint32_t offset = 1;
+
+  while (offset <= TIMER_WHEEL_SLOTS) {
+    uint32_t slot = (wheel->current + offset) & TIMER_WHEEL_MASK;
+    uint64_t word = wheel->bitmap[slot / 64] >> (slot % 64);
+
+    if (word) {
+      offset += __builtin_ctzll(word);
+      if (offset <= TIMER_WHEEL_SLOTS)
+        _s_timer_wheel_schedule(wheel, wheel->current + offset);
+      return;
+    }
+    offset += 64 - slot % 64;
+  }
+}
+
+/**
+ * @brief Kernel timer callback, expire the timers due since the last run. The
+ * slots are walked from the latest tick so that the expired list, built by
+ * its head, runs the earliest deadlines first
+ */
+static void _s_timer_wheel_cbk(daemon_unused evutil_socket_t fd,
+  daemon_unused short e, struct s_timer_wheel *wheel)
+{
+  daemon_return_if_fail(wheel);
+
+  uint64_t now = s_loop_now(wheel->loop);
+
+  wheel->scheduled = TIMER_WHEEL_NONE;
+  wheel->stats.wakeups++;
+  for (uint64_t tick = now; tick > wheel->current &&
+      now - tick < TIMER_WHEEL_SLOTS; tick--) {
+    struct s_timer *timer = wheel->slots[tick & TIMER_WHEEL_MASK];
+
+    while (timer) {
+      struct s_timer *next = timer->next;
+
+      if (timer->expires <= now) {
+        _s_timer_unlink(timer);
+        _s_timer_link(&wheel->expired, timer);
+      }
+      timer = next;
+    }
+  }
+  if (now > wheel->current)
+    wheel->current = now;
+
+  /* the callbacks may arm, cancel or free any timer, expired ones included */
+  while (wheel->expired) {
+    struct s_timer *timer = wheel->expired;
+
+    _s_timer_unlink(timer);
+    wheel->stats.expired++;
+    timer->cbk(timer, timer->userdata);
+  }
+  _s_timer_wheel_schedule_next(wheel);
+}
+
+struct s_timer_wheel *s_timer_wheel_new(struct s_loop *loop)
+{
+  daemon_return_val_if_fail(loop, NULL);
+
+  struct s_timer_wheel *wheel = daemon_zalloc(sizeof(struct s_timer_wheel));
+  wheel->event = evtimer_new(s_loop_tolibevent(loop),
+    (event_callback_fn)_s_timer_wheel_cbk, wheel);
+  wheel->loop = loop;
+  wheel->current = s_loop_now(loop);
+  wheel->scheduled = TIMER_WHEEL_NONE;
+
+  if (!wheel->event) {
+    daemon_log(LOG_ERR, "failed to allocate a timer wheel\n");
+    s_timer_wheel_free(wheel);
+    return NULL;
+  }
+  return wheel;
+}
+
+void s_timer_wheel_free(struct s_timer_wheel *wheel)
+{
+  daemon_return_if_fail(wheel);
+
+  if (wheel->event)
+    event_free(wheel->event);
+  daemon_free(wheel);
+}
+
+int s_timer_wheel_get_stats(const struct s_timer_wheel *wheel,
+  struct s_timer_stats *stats)
+{
+  daemon_return_val_if_fail(wheel, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
+
+  *stats = wheel->stats;
+  return 0;
+}
+
+struct s_timer *s_timer_new(struct s_loop *loop, s_timer_cbk cbk,
+  void *userdata)
+{
+  daemon_return_val_if_fail(loop, NULL);
+  daemon_return_val_if_fail(cbk, NULL);
+
+  struct s_timer_wheel *wheel = s_loop_towheel(loop);
+  daemon_return_val_if_fail(wheel, NULL);
+
+  struct s_timer *timer = daemon_zalloc(sizeof(struct s_timer));
+  timer->cbk = cbk;
+  timer->userdata = userdata;
+  timer->wheel = wheel;
+  return timer;
+}
+
+void s_timer_free(struct s_timer *timer)
+{
+  daemon_return_if_fail(timer);
+
+  if (timer->list)
+    _s_timer_unlink(timer);
+  daemon_free(timer);
+}
+
+int s_timer_arm(struct s_timer *timer, uint64_t delay)
+{
+  daemon_return_val_if_fail(timer, -EINVAL);
+
+  struct s_timer_wheel *wheel = timer->wheel;
+
+  if (timer->list)
+    _s_timer_unlink(timer);
+
+  /* the ticks up to the current one are already expired */
+  timer->expires = s_loop_now(wheel->loop) + delay;
+  if (timer->expires <= wheel->current)
+    timer->expires = wheel->current + 1;
+
+  uint32_t slot = timer->expires & TIMER_WHEEL_MASK;
+  _s_timer_link(&wheel->slots[slot], timer);
+  wheel->bitmap[slot / 64] |= UINT64_C(1) << (slot % 64);
+  wheel->stats.armed++;
+
+  _s_timer_wheel_schedule(wheel, timer->expires);
+  return 0;
+}
+
+int s_timer_cancel(struct s_timer *timer)
+{
+  daemon_return_val_if_fail(timer, -EINVAL);
+
+  if (timer->list) {
+    _s_timer_unlink(timer);
+    timer->wheel->stats.cancelled++;
+  }
+  return 0;
+}
+
+int s_timer_is_armed(const struct s_timer *timer)
+{
+  daemon_return_val_if_fail(timer, -EINVAL);
+
+  return timer->list ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DAEMON_TIMER_H_
+# define _DAEMON_TIMER_H_
+
+# include <stdint.h>
+# include "daemon-loop.h"
+
+/**
+ * @brief Hashed timing wheel of a loop, with a 1 ms tick. Arming and
+ * cancelling a timer are O(1), and a single libevent timer wakes the loop up
+ * for the nearest slot holding timers
+ */
+struct s_timer_wheel;
+
+struct s_timer;
+
+/**
+ * @brief Counters of a timing wheel. @wakeups counts the kernel timer
+ * expirations, shared by all the @expired timers
+ */
+struct s_timer_stats {
+  uint64_t armed;
+  uint64_t cancelled;
+  uint64_t expired;
+  uint64_t wakeups;
+};
+
+/**
+ * @brief Timer expiration callback. The timer is disarmed, it can be armed
+ * again or freed from the callback
+ * @param [in] timer: expired timer
+ * @param [in] userdata: userdata given to #s_timer_new
+ */
+typedef void (*s_timer_cbk)(struct s_timer *timer, void *userdata);
+
+/**
+ * @brief Allocate the timing wheel of a loop
+ * @param [in] loop: loop owning the wheel
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_timer_wheel *s_timer_wheel_new(struct s_loop *loop);
+
+/**
+ * @brief Deallocate a timing wheel, its timers must be freed first
+ * @param [in] wheel: wheel to delete
+ */
+void s_timer_wheel_free(struct s_timer_wheel *wheel);
+
+/**
+ * @brief Get the counters of a timing wheel
+ * @param [in] wheel: wheel to browse
+ * @param [out] stats: counters to fill
+ * @return 0 on success, an -errno value on error
+ */
+int s_timer_wheel_get_stats(const struct s_timer_wheel *wheel,
+  struct s_timer_stats *stats);
+
+/**
+ * @brief Allocate a disarmed timer on a loop, to use on the loop thread only
+ * @param [in] loop: loop running the timer
+ * @param [in] cbk: expiration callback
+ * @param [in] userdata: userdata given to @cbk
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_timer *s_timer_new(struct s_loop *loop, s_timer_cbk cbk,
+  void *userdata);
+
+/**
+ * @brief Deallocate a timer, disarming it
+ * @param [in] timer: timer to delete
+ */
+void s_timer_free(struct s_timer *timer);
+
+/**
+ * @brief Arm a timer, or move its deadline if already armed
+ * @param [in] timer: timer to arm
+ * @param [in] delay: delay in milliseconds from the loop time, 0 to expire on
+ * the next loop iteration
+ * @return 0 on success, an -errno value on error
+ */
+int s_timer_arm(struct s_timer *timer, uint64_t delay);
+
+/**
+ * @brief Disarm a timer, nothing is done if it is not armed
+ * @param [in] timer: timer to disarm
+ * @return 0 on success, an -errno value on error
+ */
+int s_timer_cancel(struct s_timer *timer);
+
+/**
+ * @brief Check if a timer is armed
+ * @param [in] timer: timer to browse
+ * @return 1 if armed, 0 if not, an -errno value on error
+ */
+int s_timer_is_armed(const struct s_timer *timer);
+
+#endif /* !_DAEMON_TIMER_H_ */
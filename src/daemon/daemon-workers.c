@@ -0,0 +1,374 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libdaemon/dlog.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-workers.h"
+
+/**
+ * @brief Queued job. The runner of a strand is a job with @strand set
+ */
+struct s_work {
+  s_task_cbk done;
+  struct s_loop *loop;
+  struct s_work *next;
+  struct s_strand *strand;
+  void *userdata;
+  s_work_cbk work;
+};
+
+/**
+ * @brief FIFO of jobs, protected by the lock of its owner
+ */
+struct s_work_queue {
+  struct s_work *head;
+  struct s_work *tail;
+};
+
+struct s_worker {
+  pthread_mutex_t lock;
+  struct s_work_queue queue;
+  pthread_t thread;
+  struct s_workers *workers;
+};
+
+struct s_strand {
+  struct s_work_queue jobs;
+  pthread_mutex_t lock;
+  uint8_t released;
+  struct s_work runner;
+  uint8_t scheduled;
+  struct s_workers *workers;
+};
+
+/**
+ * @brief Pool of workers. @pending and @sleeping are atomic: the queues are
+ * only serialized by their own lock, @lock only guards the sleeps on @cond
+ */
+struct s_workers {
+  pthread_cond_t cond;
+  uint32_t count;
+  pthread_mutex_t lock;
+  uint32_t next;
+  uint32_t pending;
+  uint32_t sleeping;
+  uint32_t started;
+  uint8_t stop;
+  struct s_worker *workers;
+};
+
+/**
+ * @brief Append a job to a queue
+ * @param [in] queue: queue to modify
+ * @param [in] work: job to append
+ */
+static void _s_work_queue_push(struct s_work_queue *queue,
+  struct s_work *work)
+{
+  work->next = NULL;
+  if (queue->tail)
+    queue->tail->next = work;
+  else
+    queue->head = work;
+  queue->tail = work;
+}
+
+/**
+ * @brief Remove the oldest job of a queue
+ * @param [in] queue: queue to modify
+ * @return a job, NULL if the queue is empty
+ */
+static struct s_work *_s_work_queue_pop(struct s_work_queue *queue)
+{
+  struct s_work *work = queue->head;
+
+  if (work) {
+    queue->head = work->next;
+    if (!queue->head)
+      queue->tail = NULL;
+  }
+  return work;
+}
+
+/**
+ * @brief Queue a job on a worker, chosen round robin, and wake a sleeping
+ * worker up
+ * @param [in] workers: pool running the job
+ * @param [in] work: job to queue
+ */
+static void _s_workers_push(struct s_workers *workers, struct s_work *work)
+{
+  uint32_t index = __atomic_fetch_add(&workers->next, 1, __ATOMIC_RELAXED);
+  struct s_worker *worker = &workers->workers[index % workers->count];
+
+  /* counted first, a worker never sees more jobs than pending ones */
+  __atomic_fetch_add(&workers->pending, 1, __ATOMIC_SEQ_CST);
+
+  pthread_mutex_lock(&worker->lock);
+  _s_work_queue_push(&worker->queue, work);
+  pthread_mutex_unlock(&worker->lock);
+
+  /* a worker going to sleep either sees the job or is seen sleeping, the
+   * lock makes sure it waits before it is signaled */
+  if (__atomic_load_n(&workers->sleeping, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&workers->lock);
+    pthread_cond_signal(&workers->cond);
+    pthread_mutex_unlock(&workers->lock);
+  }
+}
+
+/**
+ * @brief Take a job from the queue of a worker
+ * @param [in] worker: worker owning the queue
+ * @return a job, NULL if the queue is empty
+ */
+static struct s_work *_s_worker_pop(struct s_worker *worker)
+{
+  pthread_mutex_lock(&worker->lock);
+  struct s_work *work = _s_work_queue_pop(&worker->queue);
+  pthread_mutex_unlock(&worker->lock);
+  return work;
+}
+
+/**
+ * @brief Take a job from the own queue of a worker, or steal one from the
+ * other workers
+ * @param [in] worker: worker looking for a job
+ * @return a job, NULL if every queue is empty
+ */
+static struct s_work *_s_worker_take(struct s_worker *worker)
+{
+  struct s_workers *workers = worker->workers;
+  uint32_t index = worker - workers->workers;
+  struct s_work *work = NULL;
+
+  for (uint32_t i = 0; i < workers->count && !work; ++i)
+    work = _s_worker_pop(&workers->workers[(index + i) % workers->count]);
+
+  if (work)
+    __atomic_fetch_sub(&workers->pending, 1, __ATOMIC_RELAXED);
+  return work;
+}
+
+/**
+ * @brief Run a job and post its completion
+ * @param [in] work: job to run
+ */
+static void _s_work_run(struct s_work *work)
+{
+  work->work(work->userdata);
+  if (work->done && work->loop &&
+      s_loop_post(work->loop, work->done, work->userdata) < 0)
+    daemon_log(LOG_ERR, "failed to post a job completion\n");
+}
+
+/**
+ * @brief Run the next job of a strand, then queue the strand again if more
+ * jobs are pending. The strand is deallocated here once released and idle
+ * @param [in] strand: strand to run
+ */
+static void _s_strand_run(struct s_strand *strand)
+{
+  pthread_mutex_lock(&strand->lock);
+  struct s_work *work = _s_work_queue_pop(&strand->jobs);
+  pthread_mutex_unlock(&strand->lock);
+
+  if (work) {
+    _s_work_run(work);
+    daemon_free(work);
+  }
+
+  pthread_mutex_lock(&strand->lock);
+  if (strand->jobs.head) {
+    pthread_mutex_unlock(&strand->lock);
+    /* one job at a time, the other strands get their turn */
+    _s_workers_push(strand->workers, &strand->runner);
+    return;
+  }
+  strand->scheduled = 0;
+  uint8_t released = strand->released;
+  pthread_mutex_unlock(&strand->lock);
+
+  if (released) {
+    pthread_mutex_destroy(&strand->lock);
+    daemon_free(strand);
+  }
+}
+
+/**
+ * @brief Worker thread entry point
+ * @param [in] worker: worker representation
+ * @return NULL
+ */
+static void *_s_worker_main(struct s_worker *worker)
+{
+  struct s_workers *workers = worker->workers;
+
+  for (;;) {
+    struct s_work *work = _s_worker_take(worker);
+    if (work) {
+      if (work->strand) {
+        _s_strand_run(work->strand);
+      } else {
+        _s_work_run(work);
+        daemon_free(work);
+      }
+      continue;
+    }
+
+    pthread_mutex_lock(&workers->lock);
+    __atomic_fetch_add(&workers->sleeping, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&workers->pending, __ATOMIC_SEQ_CST) == 0 &&
+        !workers->stop)
+      pthread_cond_wait(&workers->cond, &workers->lock);
+    __atomic_fetch_sub(&workers->sleeping, 1, __ATOMIC_RELAXED);
+    uint8_t stop = __atomic_load_n(&workers->pending, __ATOMIC_RELAXED) == 0 &&
+      workers->stop;
+    pthread_mutex_unlock(&workers->lock);
+    if (stop)
+      break;
+  }
+  return NULL;
+}
+
+struct s_workers *s_workers_new(uint32_t count)
+{
+  if (count == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    count = cores > 0 ? cores : 1;
+  }
+
+  struct s_workers *workers = daemon_zalloc(sizeof(struct s_workers));
+  workers->count = count;
+  workers->workers = daemon_calloc(count, sizeof(struct s_worker));
+  pthread_cond_init(&workers->cond, NULL);
+  pthread_mutex_init(&workers->lock, NULL);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    struct s_worker *worker = &workers->workers[i];
+    pthread_mutex_init(&worker->lock, NULL);
+    worker->workers = workers;
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    struct s_worker *worker = &workers->workers[i];
+    int ret = pthread_create(&worker->thread, NULL,
+      (void *(*)(void *))_s_worker_main, worker);
+    if (ret != 0) {
+      daemon_log(LOG_ERR, "failed to start a worker '%s'\n", strerror(ret));
+      s_workers_free(workers);
+      return NULL;
+    }
+    workers->started++;
+  }
+  return workers;
+}
+
+void s_workers_free(struct s_workers *workers)
+{
+  daemon_return_if_fail(workers);
+
+  pthread_mutex_lock(&workers->lock);
+  workers->stop = 1;
+  pthread_cond_broadcast(&workers->cond);
+  pthread_mutex_unlock(&workers->lock);
+
+  for (uint32_t i = 0; i < workers->started; ++i)
+    pthread_join(workers->workers[i].thread, NULL);
+
+  for (uint32_t i = 0; i < workers->count; ++i)
+    pthread_mutex_destroy(&workers->workers[i].lock);
+  pthread_cond_destroy(&workers->cond);
+  pthread_mutex_destroy(&workers->lock);
+  daemon_free(workers->workers);
+  daemon_free(workers);
+}
+
+uint32_t s_workers_get_pending(struct s_workers *workers)
+{
+  daemon_return_val_if_fail(workers, 0);
+
+  return __atomic_load_n(&workers->pending, __ATOMIC_RELAXED);
+}
+
+int s_workers_submit(struct s_workers *workers, s_work_cbk work,
+  struct s_loop *loop, s_task_cbk done, void *userdata)
+{
+  daemon_return_val_if_fail(workers, -EINVAL);
+  daemon_return_val_if_fail(work, -EINVAL);
+
+  struct s_work *job = daemon_zalloc(sizeof(struct s_work));
+  job->done = done;
+  job->loop = loop;
+  job->userdata = userdata;
+  job->work = work;
+  _s_workers_push(workers, job);
+  return 0;
+}
+
+struct s_strand *s_strand_new(struct s_workers *workers)
+{
+  daemon_return_val_if_fail(workers, NULL);
+
+  struct s_strand *strand = daemon_zalloc(sizeof(struct s_strand));
+  pthread_mutex_init(&strand->lock, NULL);
+  strand->runner.strand = strand;
+  strand->workers = workers;
+  return strand;
+}
+
+void s_strand_free(struct s_strand *strand)
+{
+  daemon_return_if_fail(strand);
+
+  pthread_mutex_lock(&strand->lock);
+  strand->released = 1;
+  uint8_t scheduled = strand->scheduled;
+  pthread_mutex_unlock(&strand->lock);
+
+  /* otherwise the worker running it deallocates it */
+  if (!scheduled) {
+    pthread_mutex_destroy(&strand->lock);
+    daemon_free(strand);
+  }
+}
+
+int s_strand_submit(struct s_strand *strand, s_work_cbk work,
+  struct s_loop *loop, s_task_cbk done, void *userdata)
+{
+  daemon_return_val_if_fail(strand, -EINVAL);
+  daemon_return_val_if_fail(work, -EINVAL);
+
+  struct s_work *job = daemon_zalloc(sizeof(struct s_work));
+  job->done = done;
+  job->loop = loop;
+  job->userdata = userdata;
+  job->work = work;
+
+  pthread_mutex_lock(&strand->lock);
+  _s_work_queue_push(&strand->jobs, job);
+  uint8_t schedule = !strand->scheduled;
+  strand->scheduled = 1;
+  pthread_mutex_unlock(&strand->lock);
+
+  if (schedule)
+    _s_workers_push(strand->workers, &strand->runner);
+  return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DAEMON_WORKERS_H_
+# define _DAEMON_WORKERS_H_
+
+# include <stdint.h>
+# include "daemon-loop.h"
+
+/**
+ * @brief Job run by a worker thread
+ * @param [in] userdata: userdata given with the job
+ */
+typedef void (*s_work_cbk)(void *userdata);
+
+/**
+ * @brief Worker pool running the CPU heavy jobs off the loops. Each worker
+ * owns a queue and steals from the other ones when it runs dry
+ */
+struct s_workers;
+
+/**
+ * @brief Serialized job queue: the jobs of a strand run one at a time in
+ * submission order, on any worker
+ */
+struct s_strand;
+
+/**
+ * @brief Allocate a new worker pool and start its threads
+ * @param [in] count: number of workers, 0 for one per online core
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_workers *s_workers_new(uint32_t count);
+
+/**
+ * @brief Stop the workers once their queues are empty and deallocate the pool
+ * @param [in] workers: pool to delete
+ */
+void s_workers_free(struct s_workers *workers);
+
+/**
+ * @brief Get the number of jobs queued or running, a strand counting as one
+ * job while it has jobs left
+ * @param [in] workers: pool to browse
+ * @return the number of jobs
+ */
+uint32_t s_workers_get_pending(struct s_workers *workers);
+
+/**
+ * @brief Submit a job without ordering constraint
+ * @param [in] workers: pool running the job
+ * @param [in] work: job to run on a worker
+ * @param [in] loop: loop running @done, NULL if none
+ * @param [in] done: completion posted to @loop once @work returned, can be
+ * NULL
+ * @param [in] userdata: userdata given to @work and @done
+ * @return 0 on success, an -errno value on error
+ */
+int s_workers_submit(struct s_workers *workers, s_work_cbk work,
+  struct s_loop *loop, s_task_cbk done, void *userdata);
+
+/**
+ * @brief Allocate a new strand
+ * @param [in] workers: pool running the jobs of the strand
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_strand *s_strand_new(struct s_workers *workers);
+
+/**
+ * @brief Release a strand, it is deallocated once its pending jobs are done
+ * @param [in] strand: strand to release
+ */
+void s_strand_free(struct s_strand *strand);
+
+/**
+ * @brief Submit a job run after the previous jobs of the strand
+ * @param [in] strand: strand to append the job to
+ * @param [in] work: job to run on a worker
+ * @param [in] loop: loop running @done, NULL if none
+ * @param [in] done: completion posted to @loop once @work returned, can be
+ * NULL
+ * @param [in] userdata: userdata given to @work and @done
+ * @return 0 on success, an -errno value on error
+ */
+int s_strand_submit(struct s_strand *strand, s_work_cbk work,
+  struct s_loop *loop, s_task_cbk done, void *userdata);
+
+#endif /* !_DAEMON_WORKERS_H_ */
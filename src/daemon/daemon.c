@@ -63,7 +63,7 @@ int daemon_kill_process(void)
   return -EALREADY;
 }
 
-int daemon_load_process(void)
+int daemon_load_process(struct s_options *options)
 {
   if (daemon_close_all(-1) < 0) {
     daemon_log(LOG_ERR, "failed to close all file descriptors: %s",
@@ -82,7 +82,20 @@ int daemon_load_process(void)
     goto finish;
   }
 
-  _g_ctx = s_daemon_ctx_new(daemon_signal_fd());
+  enum e_balancer_policy policy = e_balancer_policy_two_choices;
+  const char *balancer = s_options_get_balancer(options);
+  if (balancer && s_balancer_parse(balancer, &policy) < 0) {
+    errno = ENOTSUP;
+    goto finish;
+  }
+
+  _g_ctx = s_daemon_ctx_new(daemon_signal_fd(),
+    s_options_get_threads(options), s_options_get_ktls(options));
+  if (_g_ctx && s_daemon_ctx_set_balancer(_g_ctx, policy,
+      s_options_get_peers(options)) < 0) {
+    s_daemon_ctx_free(_g_ctx);
+    _g_ctx = NULL;
+  }
   daemon_retval_send(_g_ctx ? 0 : EBADE);
 
   s_daemon_ctx_run(_g_ctx);
@@ -34,8 +34,9 @@ int daemon_kill_process(void);
 
 /**
  * @brief Start the daemon process
+ * @param [in] options: options given to the daemon process
  * @return a valid pointer on success, an errno value on error
  */
-int daemon_load_process(void);
+int daemon_load_process(struct s_options *options);
 
 #endif /* !_DAEMON_H_ */
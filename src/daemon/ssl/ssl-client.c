@@ -20,11 +20,15 @@
 #include <event2/event.h>
 #include <event2/bufferevent_ssl.h>
 #include <libdaemon/dlog.h>
-#include <netinet/in.h>
+#include <openssl/err.h>
+#include <stdio.h>
 
+#include "daemon-address.h"
 #include "daemon-alloc.h"
 #include "daemon-cond.h"
+#include "daemon-race.h"
 #include "ssl/ssl-client.h"
+#include "ssl/ssl-context.h"
 
 struct s_ssl_client {
   struct s_ssl_funcs funcs;
@@ -34,11 +38,258 @@ struct s_ssl_client {
   struct {
     struct bufferevent *buffer;
     SSL_CTX *context;
+    uint8_t ktls;
   } ssl;
 
+  struct {
+    struct event *flush;
+    struct evbuffer *staging;
+    size_t threshold;
+    struct timeval delay;
+  } coalescing;
+
+  struct {
+    uint8_t congested;
+    size_t high;
+    size_t low;
+  } backpressure;
+
+  struct {
+    struct s_loop *loop;
+    struct s_ssl_handshake *pending;
+    struct s_race *race;
+  } handshake;
+
+  struct {
+    struct s_ssl_sessions *cache;
+    char *key;
+  } session;
+
+  struct s_ssl_client_stats stats;
+  struct s_ssl_view view;
+  size_t watermark;
+
   void *userdata;
 };
 
+/**
+ * @brief Default amount of staged bytes triggering a flush, the size of a full
+ * TLS record
+ */
+#define SSL_COALESCING_THRESHOLD (16 * 1024)
+
+/**
+ * @brief Timeout in seconds of an offloaded handshake
+ */
+#define SSL_HANDSHAKE_TIMEOUT 10
+
+/**
+ * @brief Handshake performed on another loop. The ssl connection and the
+ * socket stay owned by the handshake until it completes back on the loop of
+ * the client, @client is cleared if the client is freed meanwhile
+ */
+struct s_ssl_handshake {
+  struct bufferevent *buffer;
+  struct s_ssl_client *client;
+  struct sockaddr_storage dest;
+  int error;
+  evutil_socket_t fd;
+  struct s_loop *handshaker;
+  struct s_loop *loop;
+  int ret;
+  SSL *ssl;
+  enum bufferevent_ssl_state state;
+};
+
+/**
+ * @brief Protocol message callback, used to count the records emitted
+ * @param [in] write_p: 1 for an outgoing message
+ * @param [in] content_type: SSL3_RT_HEADER for a record header
+ * @param [in] buf: message content, the record header
+ * @param [in] len: message size
+ * @param [in] ssl: ssl connection, its app data is the ssl client
+ */
+static void _s_ssl_client_message(int write_p, daemon_unused int version,
+  int content_type, const void *buf, size_t len, SSL *ssl,
+  daemon_unused void *arg)
+{
+  struct s_ssl_client *client = SSL_get_app_data(ssl);
+  const uint8_t *header = buf;
+
+  if (client && write_p && content_type == SSL3_RT_HEADER && len > 0 &&
+      header[0] == SSL3_RT_APPLICATION_DATA)
+    client->stats.records++;
+}
+
+/**
+ * @brief New session callback, stores the sessions and TLS 1.3 tickets sent by
+ * the server in the session cache of the client
+ * @param [in] ssl: ssl connection, its app data is the ssl client
+ * @param [in] session: new session
+ * @return 1 if the session reference is kept, 0 otherwise
+ */
+static int _s_ssl_client_session(SSL *ssl, SSL_SESSION *session)
+{
+  struct s_ssl_client *client = SSL_get_app_data(ssl);
+
+  if (!client || !client->session.cache || !client->session.key)
+    return 0;
+  return s_ssl_sessions_put(client->session.cache, session,
+    client->session.key) == 0;
+}
+
+/**
+ * @brief Build the session cache key of a client, its name and destination
+ * @param [in] client: client to modify
+ * @param [in] dest: destination address
+ */
+static void _s_ssl_client_session_key(struct s_ssl_client *client,
+  const struct sockaddr_storage *dest)
+{
+  char address[ADDRESS_STR_MAX];
+
+  if (s_address_to_string(dest, address, sizeof(address)) < 0)
+    return;
+
+  size_t size = strlen(client->name) + strlen(address) + 2;
+  if (client->session.key)
+    daemon_free(client->session.key);
+  client->session.key = daemon_malloc(size);
+  snprintf(client->session.key, size, "%s@%s", client->name, address);
+}
+
+/**
+ * @brief Offer the cached session of the peer, if any, before connecting
+ * @param [in] client: client to connect
+ * @param [in] ssl: ssl connection to resume
+ * @param [in] dest: destination address
+ */
+static void _s_ssl_client_session_resume(struct s_ssl_client *client,
+  SSL *ssl, const struct sockaddr_storage *dest)
+{
+  _s_ssl_client_session_key(client, dest);
+  if (client->session.key)
+    s_ssl_sessions_resume(client->session.cache, ssl, client->session.key);
+}
+
+/**
+ * @brief Move the staged data to the bufferevent output buffer
+ * @param [in] client: ssl client representation
+ */
+static void _s_ssl_client_flush(struct s_ssl_client *client)
+{
+  struct evbuffer *staging = client->coalescing.staging;
+
+  if (!client->ssl.buffer || evbuffer_get_length(staging) == 0)
+    return;
+
+  /* chains are moved, not copied */
+  event_del(client->coalescing.flush);
+  if (evbuffer_add_buffer(bufferevent_get_output(client->ssl.buffer),
+        staging) == 0)
+    client->stats.flushes++;
+}
+
+/**
+ * @brief Flush timer callback, raised once per loop iteration (or after the
+ * configured delay) when data is staged
+ */
+static void _s_ssl_client_flush_cbk(daemon_unused evutil_socket_t fd,
+  daemon_unused short e, struct s_ssl_client *client)
+{
+  daemon_return_if_fail(client);
+
+  _s_ssl_client_flush(client);
+}
+
+/**
+ * @brief Get the buffer receiving the writes: the staging buffer when the
+ * coalescing is enabled, the bufferevent output buffer otherwise
+ * @param [in] client: ssl client representation
+ * @return a valid pointer
+ */
+static struct evbuffer *_s_ssl_client_output(struct s_ssl_client *client)
+{
+  return client->coalescing.staging ? client->coalescing.staging :
+    bufferevent_get_output(client->ssl.buffer);
+}
+
+/**
+ * @brief Get the number of bytes waiting to be sent
+ * @param [in] client: ssl client representation
+ * @return the staged and buffered bytes
+ */
+static size_t _s_ssl_client_pending(struct s_ssl_client *client)
+{
+  size_t pending = client->coalescing.staging ?
+    evbuffer_get_length(client->coalescing.staging) : 0;
+
+  if (client->ssl.buffer)
+    pending += evbuffer_get_length(bufferevent_get_output(client->ssl.buffer));
+  return pending;
+}
+
+/**
+ * @brief Update the congestion status against the watermarks and notify the
+ * application on a change
+ * @param [in] client: ssl client representation
+ */
+static void _s_ssl_client_congestion(struct s_ssl_client *client)
+{
+  if (!client->backpressure.high)
+    return;
+
+  size_t pending = _s_ssl_client_pending(client);
+  if (!client->backpressure.congested &&
+      pending >= client->backpressure.high) {
+    client->backpressure.congested = 1;
+    client->stats.congestions++;
+    if (client->funcs.congestion)
+      client->funcs.congestion(client->userdata, e_ssl_congestion_congested);
+  } else if (client->backpressure.congested &&
+             pending <= client->backpressure.low) {
+    client->backpressure.congested = 0;
+    if (client->funcs.congestion)
+      client->funcs.congestion(client->userdata, e_ssl_congestion_writable);
+  }
+}
+
+/**
+ * @brief Write callback for a bufferevent.
+ * The write callback is triggered when the output buffer is drained down to
+ * the write low watermark, which is the backpressure low watermark
+ * @param [in] buffer: buffer drained
+ * @param [in] client: ssl client representation
+ */
+static void _s_ssl_client_drained(struct bufferevent *buffer,
+  struct s_ssl_client *client)
+{
+  daemon_return_if_fail(buffer);
+  daemon_return_if_fail(client);
+
+  _s_ssl_client_congestion(client);
+}
+
+/**
+ * @brief Account a message written and schedule the flush of the staged data
+ * @param [in] client: ssl client representation
+ * @param [in] size: message size
+ */
+static void _s_ssl_client_written(struct s_ssl_client *client, size_t size)
+{
+  client->stats.messages++;
+  client->stats.bytes += size;
+
+  if (client->coalescing.staging) {
+    if (evbuffer_get_length(client->coalescing.staging) >=
+        client->coalescing.threshold)
+      _s_ssl_client_flush(client);
+    else if (!event_pending(client->coalescing.flush, EV_TIMEOUT, NULL))
+      event_add(client->coalescing.flush, &client->coalescing.delay);
+  }
+  _s_ssl_client_congestion(client);
+}
+
 /**
  * @brief Generate a packet instance from the data gather inside the buffer
  * @param [in] buffer: buffer concerned by that process
@@ -48,16 +299,90 @@ static struct s_ssl_packet *_s_ssl_packet_generate(struct bufferevent *buffer)
 {
   daemon_return_val_if_fail(buffer, NULL);
 
-  struct evbuffer *event = evbuffer_new();
-  daemon_return_val_if_fail(bufferevent_read_buffer(buffer, event) == 0, NULL);
+  /* copy straight from the input chain into the packet payload */
+  struct evbuffer *input = bufferevent_get_input(buffer);
+  struct s_ssl_packet *packet = s_ssl_packet_alloc(
+    evbuffer_get_length(input));
 
-  struct s_ssl_packet *packet = s_ssl_packet_new(evbuffer_pullup(event, -1),
-    evbuffer_get_length(event));
-
-  evbuffer_free(event);
+  if (evbuffer_remove(input, packet->payload, packet->size) < 0) {
+    s_ssl_packet_free(packet);
+    return NULL;
+  }
   return packet;
 }
 
+/**
+ * @brief Stop a connection whose stream is broken, it can not be
+ * resynchronized: nothing is read nor sent anymore and the application is
+ * told the connection failed
+ * @param [in] buffer: buffer of the connection
+ * @param [in] client: ssl client representation
+ * @param [in] err: an -errno value
+ */
+static void _s_ssl_client_abort(struct bufferevent *buffer,
+  struct s_ssl_client *client, int err)
+{
+  struct evbuffer *input = bufferevent_get_input(buffer);
+
+  bufferevent_disable(buffer, EV_READ | EV_WRITE);
+  evbuffer_drain(input, evbuffer_get_length(input));
+  client->funcs.error(client->userdata, e_ssl_error_connection, err, NULL);
+}
+
+/**
+ * @brief Deliver every complete frame available in the input buffer, then
+ * raise the read low watermark to the size of the next frame so the read
+ * callback is not triggered before it is complete
+ * @param [in] buffer: buffer to read
+ * @param [in] client: ssl client representation
+ */
+static void _s_ssl_client_read_frames(struct bufferevent *buffer,
+  struct s_ssl_client *client)
+{
+  struct evbuffer *input = bufferevent_get_input(buffer);
+  size_t watermark = SSL_FRAME_HEADER_SIZE;
+
+  for (;;) {
+    uint8_t header[SSL_FRAME_HEADER_SIZE];
+    struct s_ssl_frame frame;
+    size_t length = evbuffer_get_length(input);
+
+    if (length < SSL_FRAME_HEADER_SIZE)
+      break;
+
+    evbuffer_copyout(input, header, SSL_FRAME_HEADER_SIZE);
+    int ret = s_ssl_frame_decode(header, &frame);
+    if (ret < 0) {
+      daemon_log(LOG_ERR, "invalid frame received on '%s'\n", client->name);
+      _s_ssl_client_abort(buffer, client, ret);
+      return;
+    }
+
+    if (length < SSL_FRAME_HEADER_SIZE + frame.size) {
+      watermark = SSL_FRAME_HEADER_SIZE + frame.size;
+      break;
+    }
+
+    /* only linearize the payload when it spans several chains */
+    evbuffer_drain(input, SSL_FRAME_HEADER_SIZE);
+    if (frame.size) {
+      frame.payload = evbuffer_pullup(input, frame.size);
+      if (!frame.payload) {
+        daemon_log(LOG_ERR, "failed to read a frame on '%s'\n", client->name);
+        _s_ssl_client_abort(buffer, client, -ENOMEM);
+        return;
+      }
+    }
+    client->funcs.frame(client->userdata, &frame);
+    evbuffer_drain(input, frame.size);
+  }
+
+  if (watermark != client->watermark) {
+    bufferevent_setwatermark(buffer, EV_READ, watermark, 0);
+    client->watermark = watermark;
+  }
+}
+
 /**
  * @brief Read callback for a bufferevent.
  * The read callback is triggered when new data arrives in the input buffer and
@@ -71,13 +396,46 @@ static void _s_ssl_client_read(struct bufferevent *buffer,
   daemon_return_if_fail(buffer);
   daemon_return_if_fail(client);
 
-  if (client->funcs.read) {
+  if (client->funcs.frame) {
+    _s_ssl_client_read_frames(buffer, client);
+  } else if (client->funcs.view) {
+    struct s_ssl_view *view = &client->view;
+    daemon_return_if_fail(s_ssl_view_map(view,
+      bufferevent_get_input(buffer)) == 0);
+    client->funcs.view(client->userdata, view);
+    s_ssl_view_unmap(view);
+  } else if (client->funcs.read) {
     struct s_ssl_packet *packet = _s_ssl_packet_generate(buffer);
     client->funcs.read(client->userdata, packet);
     s_ssl_packet_free(packet);
   }
 }
 
+/**
+ * @brief Handshake completion, account the session resumption and notify
+ * @param [in] client: ssl client representation
+ * @param [in] ssl: established ssl connection
+ */
+static void _s_ssl_client_connected(struct s_ssl_client *client, SSL *ssl)
+{
+  if (client->session.cache)
+    s_ssl_sessions_handshake(client->session.cache, SSL_session_reused(ssl));
+  client->funcs.connection(client->userdata, e_ssl_connection_connected);
+}
+
+/**
+ * @brief Handshake failure, forget the session offered and notify
+ * @param [in] client: ssl client representation
+ * @param [in] err: ssl error
+ */
+static void _s_ssl_client_failed(struct s_ssl_client *client, int err)
+{
+  /* do not offer again a session which may be the failure reason */
+  if (client->session.cache && client->session.key)
+    s_ssl_sessions_remove(client->session.cache, client->session.key);
+  client->funcs.error(client->userdata, e_ssl_error_connection, err, NULL);
+}
+
 /**
  * @brief An event/error callback for a bufferevent.
  * The event callback is triggered if either an EOF condition or another
@@ -100,7 +458,7 @@ static void _s_ssl_client_event(struct bufferevent *buffer, short what,
   } else if ((what & BEV_EVENT_TIMEOUT) == BEV_EVENT_TIMEOUT) {
     client->funcs.connection(client->userdata, e_ssl_connection_timeout);
   } else if ((what & BEV_EVENT_CONNECTED) == BEV_EVENT_CONNECTED) {
-    client->funcs.connection(client->userdata, e_ssl_connection_connected);
+    _s_ssl_client_connected(client, bufferevent_openssl_get_ssl(buffer));
   } else {
     int err = bufferevent_get_openssl_error(buffer);
     enum e_ssl_error error = (what & BEV_EVENT_READING) == BEV_EVENT_READING ?
@@ -110,7 +468,7 @@ static void _s_ssl_client_event(struct bufferevent *buffer, short what,
         e_ssl_error_connection;
 
     if (e_ssl_error_connection == error) {
-      client->funcs.error(client->userdata, error, err, NULL);
+      _s_ssl_client_failed(client, err);
     } else {
       struct s_ssl_packet *packet = _s_ssl_packet_generate(buffer);
       client->funcs.error(client->userdata, error, err, packet);
@@ -126,7 +484,7 @@ struct s_ssl_client *s_ssl_client_new(struct s_loop *loop,
   daemon_return_val_if_fail(funcs, NULL);
   daemon_return_val_if_fail(s_ssl_funcs_check(funcs) == 0, NULL);
 
-  struct s_ssl_client *client = daemon_malloc(sizeof(struct s_ssl_client));
+  struct s_ssl_client *client = daemon_zalloc(sizeof(struct s_ssl_client));
   client->funcs = *funcs;
   client->loop = loop;
   client->name = strdup("unknown");
@@ -138,46 +496,353 @@ void s_ssl_client_free(struct s_ssl_client *client)
 {
   daemon_return_if_fail(client);
 
+  /* the staged bytes go out before the shutdown, while the buffer lives */
+  s_ssl_client_set_coalescing(client, NULL);
   if (client->ssl.context) {
-    s_ssl_context_deinit();
     if (client->ssl.buffer) {
       SSL_set_shutdown(bufferevent_openssl_get_ssl(client->ssl.buffer),
         SSL_RECEIVED_SHUTDOWN);
       SSL_shutdown(bufferevent_openssl_get_ssl(client->ssl.buffer));
       bufferevent_free(client->ssl.buffer);
+      client->ssl.buffer = NULL;
     }
-    SSL_CTX_free(client->ssl.context);
+    s_ssl_context_put(client->ssl.context);
   }
+  if (client->handshake.pending)
+    client->handshake.pending->client = NULL;
+  if (client->handshake.race)
+    s_race_free(client->handshake.race);
+  s_ssl_view_clear(&client->view);
+  if (client->session.key)
+    daemon_free(client->session.key);
   daemon_free(client->name);
   daemon_free(client);
 }
 
+/**
+ * @brief Allocate the ssl connection of a client, with its options
+ * @param [in] client: client to set up
+ * @return a valid pointer on success, NULL on error
+ */
+static SSL *_s_ssl_client_ssl_new(struct s_ssl_client *client)
+{
+  SSL *ssl = SSL_new(client->ssl.context);
+
+#ifdef SSL_OP_ENABLE_KTLS
+  /* kept in userspace when the kernel or the cipher do not support it */
+  if (ssl && client->ssl.ktls)
+    SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif
+  return ssl;
+}
+
+/**
+ * @brief Wrap a ssl connection into the bufferevent of a client
+ * @param [in] client: client to set up
+ * @param [in] ssl: ssl connection, owned by the bufferevent, released on error
+ * @param [in] fd: connected socket, -1 to connect later, left to the caller
+ * on error
+ * @param [in] state: handshake side
+ * @return 0 on success, an -errno value on error
+ */
+static int _s_ssl_client_open(struct s_ssl_client *client, SSL *ssl,
+  evutil_socket_t fd, enum bufferevent_ssl_state state)
+{
+  SSL_set_app_data(ssl, client);
+  SSL_set_msg_callback(ssl, _s_ssl_client_message);
+  uint32_t flags = BEV_OPT_DEFER_CALLBACKS | BEV_OPT_CLOSE_ON_FREE;
+  client->ssl.buffer = bufferevent_openssl_socket_new(
+    s_loop_tolibevent(client->loop), fd, ssl, state, flags);
+  if (!client->ssl.buffer) {
+    SSL_free(ssl);
+    return -EBADE;
+  }
+
+  bufferevent_setcb(client->ssl.buffer,
+    (bufferevent_data_cb)_s_ssl_client_read,
+    (bufferevent_data_cb)_s_ssl_client_drained,
+    (bufferevent_event_cb)_s_ssl_client_event, client);
+  bufferevent_setwatermark(client->ssl.buffer, EV_WRITE,
+    client->backpressure.low, 0);
+  if (client->funcs.frame) {
+    client->watermark = SSL_FRAME_HEADER_SIZE;
+    bufferevent_setwatermark(client->ssl.buffer, EV_READ,
+      client->watermark, 0);
+  }
+  /* the TLS 1.3 session tickets come after the handshake, read them too */
+  bufferevent_enable(client->ssl.buffer, EV_READ | EV_WRITE);
+  return 0;
+}
+
+/**
+ * @brief Handshake completion, runs back on the loop of the client to attach
+ * the established connection
+ * @param [in] handshake: completed handshake
+ */
+static void _s_ssl_handshake_done(struct s_ssl_handshake *handshake)
+{
+  struct s_ssl_client *client = handshake->client;
+  SSL *ssl = handshake->ssl;
+  evutil_socket_t fd = handshake->fd;
+  enum bufferevent_ssl_state state = handshake->state;
+  int error = handshake->error;
+  int ret = handshake->ret;
+
+  daemon_free(handshake);
+  if (!client || ret < 0) {
+    SSL_free(ssl);
+    if (fd >= 0)
+      evutil_closesocket(fd);
+    if (client) {
+      client->handshake.pending = NULL;
+      _s_ssl_client_failed(client, error);
+    }
+    return;
+  }
+  client->handshake.pending = NULL;
+
+  /* the session callback was not reachable during the handshake */
+  if (state == BUFFEREVENT_SSL_CONNECTING && client->session.cache &&
+      client->session.key && SSL_version(ssl) < TLS1_3_VERSION) {
+    SSL_SESSION *session = SSL_get1_session(ssl);
+
+    if (session && s_ssl_sessions_put(client->session.cache, session,
+        client->session.key) < 0)
+      SSL_SESSION_free(session);
+  }
+
+  if (_s_ssl_client_open(client, ssl, fd, BUFFEREVENT_SSL_OPEN) < 0) {
+    if (fd >= 0)
+      evutil_closesocket(fd);
+    _s_ssl_client_failed(client, 0);
+  } else {
+    _s_ssl_client_connected(client, ssl);
+  }
+}
+
+/**
+ * @brief Move a finished handshake to the loop of its client
+ * @param [in] handshake: finished handshake
+ */
+static void _s_ssl_handshake_leave(struct s_ssl_handshake *handshake)
+{
+  if (s_loop_post(handshake->loop, (s_task_cbk)_s_ssl_handshake_done,
+      handshake) < 0)
+    daemon_log(LOG_ERR, "failed to complete a ssl handshake\n");
+}
+
+/**
+ * @brief Release the bufferevent of a finished handshake
+ * @param [in] handshake: finished handshake
+ * @param [in] ret: 0 on success, an -errno value on error
+ */
+static void _s_ssl_handshake_finish(struct s_ssl_handshake *handshake,
+  int ret)
+{
+  handshake->ret = ret;
+  if (handshake->buffer) {
+    handshake->error = (int)bufferevent_get_openssl_error(handshake->buffer);
+    handshake->fd = bufferevent_getfd(handshake->buffer);
+    /* neither the ssl connection nor the socket are released here */
+    bufferevent_free(handshake->buffer);
+    handshake->buffer = NULL;
+  }
+  /* the socket leaves once the loop applied the removal of its events */
+  if (s_loop_post(handshake->handshaker, (s_task_cbk)_s_ssl_handshake_leave,
+      handshake) < 0)
+    daemon_log(LOG_ERR, "failed to complete a ssl handshake\n");
+}
+
+/**
+ * @brief Event callback of a handshake, on the handshake loop
+ * @param [in] buffer: bufferevent performing the handshake
+ * @param [in] what: BEV_EVENT_CONNECTED once established, an error otherwise
+ * @param [in] handshake: handshake in progress
+ */
+static void _s_ssl_handshake_event(daemon_unused struct bufferevent *buffer,
+  short what, struct s_ssl_handshake *handshake)
+{
+  if ((what & BEV_EVENT_CONNECTED) == BEV_EVENT_CONNECTED)
+    _s_ssl_handshake_finish(handshake, 0);
+  else if ((what & BEV_EVENT_TIMEOUT) == BEV_EVENT_TIMEOUT)
+    _s_ssl_handshake_finish(handshake, -ETIMEDOUT);
+  else
+    _s_ssl_handshake_finish(handshake, -ECONNABORTED);
+}
+
+/**
+ * @brief Start a handshake, runs on the handshake loop. The bufferevent is
+ * neither enabled nor owning the connection: it only drives the handshake and
+ * nothing past it is read
+ * @param [in] handshake: handshake to start
+ */
+static void _s_ssl_handshake_start(struct s_ssl_handshake *handshake)
+{
+  struct timeval timeout = { SSL_HANDSHAKE_TIMEOUT, 0 };
+
+  handshake->buffer = bufferevent_openssl_socket_new(
+    s_loop_tolibevent(handshake->handshaker), handshake->fd, handshake->ssl,
+    handshake->state, 0);
+  if (!handshake->buffer) {
+    _s_ssl_handshake_finish(handshake, -EBADE);
+    return;
+  }
+
+  bufferevent_setcb(handshake->buffer, NULL, NULL,
+    (bufferevent_event_cb)_s_ssl_handshake_event, handshake);
+  bufferevent_set_timeouts(handshake->buffer, &timeout, &timeout);
+  if (handshake->fd < 0 && bufferevent_socket_connect(handshake->buffer,
+      (struct sockaddr *)&handshake->dest,
+      s_address_get_size(&handshake->dest)) < 0)
+    _s_ssl_handshake_finish(handshake, -ECONNREFUSED);
+}
+
+/**
+ * @brief Perform the handshake of a client on its handshake loop
+ * @param [in] client: client to set up
+ * @param [in] ssl: ssl connection to establish
+ * @param [in] fd: accepted or connected socket, -1 to connect to @dest
+ * @param [in] dest: destination address, NULL when accepting
+ * @param [in] state: handshake side
+ * @return 0 on success, an -errno value on error
+ */
+static int _s_ssl_client_handshake(struct s_ssl_client *client, SSL *ssl,
+  evutil_socket_t fd, const struct sockaddr_storage *dest,
+  enum bufferevent_ssl_state state)
+{
+  struct s_ssl_handshake *handshake = daemon_zalloc(
+    sizeof(struct s_ssl_handshake));
+  handshake->client = client;
+  if (dest)
+    handshake->dest = *dest;
+  handshake->fd = fd;
+  handshake->handshaker = client->handshake.loop;
+  handshake->loop = client->loop;
+  handshake->ssl = ssl;
+  handshake->state = state;
+
+  int ret = s_loop_post(handshake->handshaker,
+    (s_task_cbk)_s_ssl_handshake_start, handshake);
+  if (ret < 0) {
+    daemon_free(handshake);
+    return ret;
+  }
+  client->handshake.pending = handshake;
+  return 0;
+}
+
+/**
+ * @brief Start the client side handshake, on a socket connected by a race or
+ * on a socket connecting to @dest
+ * @param [in] client: client to set up
+ * @param [in] fd: connected socket, -1 to connect to @dest
+ * @param [in] dest: destination address
+ * @return 0 on success, an -errno value on error
+ */
+static int _s_ssl_client_start(struct s_ssl_client *client,
+  evutil_socket_t fd, const struct sockaddr_storage *dest)
+{
+  SSL *ssl = _s_ssl_client_ssl_new(client);
+  daemon_return_val_if_fail(ssl, -ENOMEM);
+
+  if (client->session.cache)
+    _s_ssl_client_session_resume(client, ssl, dest);
+
+  if (client->handshake.loop && _s_ssl_client_handshake(client, ssl, fd,
+      dest, BUFFEREVENT_SSL_CONNECTING) == 0)
+    return 0;
+
+  int ret = _s_ssl_client_open(client, ssl, fd, BUFFEREVENT_SSL_CONNECTING);
+  if (ret < 0 || fd >= 0)
+    return ret;
+
+  return bufferevent_socket_connect(client->ssl.buffer,
+    (struct sockaddr *)dest, s_address_get_size(dest));
+}
+
+/**
+ * @brief Completion of the connection race of a client, the handshake starts
+ * on the winning socket
+ * @param [in] client: client connecting
+ * @param [in] fd: connected socket, -1 if every address failed
+ * @param [in] address: address of @fd
+ * @param [in] error: 0 on success, an -errno value on error
+ */
+static void _s_ssl_client_raced(struct s_ssl_client *client,
+  evutil_socket_t fd, const struct sockaddr_storage *address,
+  daemon_unused int error)
+{
+  struct sockaddr_storage dest;
+
+  if (fd >= 0)
+    dest = *address;
+  s_race_free(client->handshake.race);
+  client->handshake.race = NULL;
+
+  if (fd < 0) {
+    _s_ssl_client_failed(client, 0);
+  } else if (_s_ssl_client_start(client, fd, &dest) < 0) {
+    evutil_closesocket(fd);
+    _s_ssl_client_failed(client, 0);
+  }
+}
+
 int s_ssl_client_connect(struct s_ssl_client *client,
-  const char *certificate, const struct sockaddr_in *dest)
+  const char *certificate, const struct sockaddr_storage *dests,
+  uint32_t count)
 {
   daemon_return_val_if_fail(client, -EINVAL);
   daemon_return_val_if_fail(certificate, -EINVAL);
-  daemon_return_val_if_fail(dest, -EINVAL);
+  daemon_return_val_if_fail(dests, -EINVAL);
+  daemon_return_val_if_fail(count > 0, -EINVAL);
 
-  if (!client->ssl.buffer) {
-    client->ssl.context = s_ssl_context_client_new(certificate);
-    daemon_return_val_if_fail(client->ssl.context, -EBADE);
+  if (client->ssl.buffer || client->handshake.pending ||
+      client->handshake.race)
+    return 0;
 
-    SSL *ssl = SSL_new(client->ssl.context);
-    uint32_t flags = BEV_OPT_DEFER_CALLBACKS | BEV_OPT_CLOSE_ON_FREE;
-    client->ssl.buffer = bufferevent_openssl_socket_new(
-      s_loop_tolibevent(client->loop), -1, ssl, BUFFEREVENT_SSL_CONNECTING,
-      flags);
-    daemon_return_val_if_fail(client->ssl.buffer, -EBADE);
+  client->ssl.context = s_ssl_context_client_get(certificate,
+    _s_ssl_client_session);
+  daemon_return_val_if_fail(client->ssl.context, -EBADE);
 
-    bufferevent_setcb(client->ssl.buffer,
-      (bufferevent_data_cb)_s_ssl_client_read, NULL,
-      (bufferevent_event_cb)_s_ssl_client_event, client);
+  /* a single address needs no race, libevent connects it */
+  if (count == 1)
+    return _s_ssl_client_start(client, -1, &dests[0]);
 
-    return bufferevent_socket_connect(client->ssl.buffer,
-      (struct sockaddr *)dest, sizeof(*dest));
+  client->handshake.race = s_race_new(client->loop, dests, count,
+    (s_race_cbk)_s_ssl_client_raced, client);
+  return client->handshake.race ? 0 : -errno;
+}
+
+int s_ssl_client_accept(struct s_ssl_client *client, const char *certificate,
+  const char *private_key, evutil_socket_t fd)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+  daemon_return_val_if_fail(certificate, -EINVAL);
+  daemon_return_val_if_fail(private_key, -EINVAL);
+  daemon_return_val_if_fail(fd >= 0, -EINVAL);
+  daemon_return_val_if_fail(!client->ssl.buffer, -EALREADY);
+  daemon_return_val_if_fail(!client->handshake.pending, -EALREADY);
+  daemon_return_val_if_fail(!client->handshake.race, -EALREADY);
+
+  int ret = -EBADE;
+  SSL *ssl = NULL;
+
+  client->ssl.context = s_ssl_context_server_get(certificate, private_key);
+  if (client->ssl.context)
+    ssl = _s_ssl_client_ssl_new(client);
+
+  if (ssl) {
+    if (client->handshake.loop && _s_ssl_client_handshake(client, ssl, fd,
+        NULL, BUFFEREVENT_SSL_ACCEPTING) == 0)
+      return 0;
+    ret = _s_ssl_client_open(client, ssl, fd, BUFFEREVENT_SSL_ACCEPTING);
+    if (ret == 0)
+      return 0;
   }
-  return 0;
+
+  /* nobody else waits for this connection, the owner learns it failed */
+  _s_ssl_client_failed(client, 0);
+  return ret;
 }
 
 int s_ssl_client_set_name(struct s_ssl_client *client, const char *name)
@@ -190,11 +855,282 @@ int s_ssl_client_set_name(struct s_ssl_client *client, const char *name)
   return 0;
 }
 
+int s_ssl_client_set_handshake_loop(struct s_ssl_client *client,
+  struct s_loop *loop)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+
+  client->handshake.loop = loop != client->loop ? loop : NULL;
+  return 0;
+}
+
+int s_ssl_client_set_ktls(struct s_ssl_client *client, uint8_t enable)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+
+#ifdef SSL_OP_ENABLE_KTLS
+  client->ssl.ktls = !!enable;
+  return 0;
+#else
+  return enable ? -ENOTSUP : 0;
+#endif
+}
+
+int s_ssl_client_is_ktls(const struct s_ssl_client *client)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+
+#ifdef SSL_OP_ENABLE_KTLS
+  if (client->ssl.buffer)
+    return BIO_get_ktls_send(SSL_get_wbio(
+      bufferevent_openssl_get_ssl(client->ssl.buffer))) ? 1 : 0;
+#endif
+  return 0;
+}
+
+int s_ssl_client_set_session_cache(struct s_ssl_client *client,
+  struct s_ssl_sessions *cache)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+
+  client->session.cache = cache;
+  return 0;
+}
+
 int s_ssl_client_write(struct s_ssl_client *client,
   const struct s_ssl_packet *packet)
 {
   daemon_return_val_if_fail(client, -EINVAL);
   daemon_return_val_if_fail(packet, -EINVAL);
 
-  return bufferevent_write(client->ssl.buffer, packet->payload, packet->size);
+  struct iovec iov = { .iov_base = packet->payload, .iov_len = packet->size };
+  return s_ssl_client_writev(client, &iov, 1);
+}
+
+int s_ssl_client_writev(struct s_ssl_client *client, const struct iovec *iov,
+  uint32_t count)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+  daemon_return_val_if_fail(client->ssl.buffer, -ENOTCONN);
+  daemon_return_val_if_fail(iov || !count, -EINVAL);
+
+  if (client->backpressure.congested)
+    return -EAGAIN;
+
+  size_t size = 0;
+  for (uint32_t i = 0; i < count; ++i)
+    size += iov[i].iov_len;
+  if (!size)
+    return 0;
+
+  /* reserve the whole batch at once: a single copy into at most two chains
+   * and a single output callback, so the ssl layer can build full records */
+  struct evbuffer *output = _s_ssl_client_output(client);
+  struct evbuffer_iovec space[2];
+  int n = evbuffer_reserve_space(output, size, space, 2);
+  daemon_return_val_if_fail(n > 0, -ENOMEM);
+
+  int extent = 0;
+  size_t used = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint8_t *data = iov[i].iov_base;
+    size_t length = iov[i].iov_len;
+    while (length > 0) {
+      if (used == space[extent].iov_len) {
+        extent++;
+        used = 0;
+      }
+      size_t chunk = space[extent].iov_len - used;
+      if (chunk > length)
+        chunk = length;
+      memcpy((uint8_t *)space[extent].iov_base + used, data, chunk);
+      used += chunk;
+      data += chunk;
+      length -= chunk;
+    }
+  }
+  space[extent].iov_len = used;
+
+  daemon_return_val_if_fail(evbuffer_commit_space(output, space,
+    extent + 1) == 0, -ENOMEM);
+  _s_ssl_client_written(client, size);
+  return 0;
+}
+
+int s_ssl_client_write_reference(struct s_ssl_client *client,
+  const void *data, size_t size, s_ssl_cleanup_cbk cleanup, void *userdata)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+  daemon_return_val_if_fail(data, -EINVAL);
+  daemon_return_val_if_fail(cleanup, -EINVAL);
+
+  if (!client->ssl.buffer || client->backpressure.congested) {
+    cleanup(data, size, userdata);
+    return client->ssl.buffer ? -EAGAIN : -ENOTCONN;
+  }
+
+  struct evbuffer *output = _s_ssl_client_output(client);
+  if (evbuffer_add_reference(output, data, size, cleanup, userdata) < 0) {
+    cleanup(data, size, userdata);
+    return -ENOMEM;
+  }
+  _s_ssl_client_written(client, size);
+  return 0;
+}
+
+int s_ssl_client_sendfile(struct s_ssl_client *client, int fd, off_t offset,
+  size_t size)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+  daemon_return_val_if_fail(fd >= 0, -EINVAL);
+
+  if (!client->ssl.buffer)
+    return -ENOTCONN;
+  if (client->backpressure.congested)
+    return -EAGAIN;
+
+  /* mapped (or read) right away rather than when added to the buffer, so
+   * nothing is sent if the file cannot be read */
+  struct evbuffer_file_segment *segment = evbuffer_file_segment_new(fd,
+    offset, size, EVBUF_FS_DISABLE_SENDFILE);
+  daemon_return_val_if_fail(segment, -ENOMEM);
+
+  size_t sent = 0;
+#ifdef SSL_OP_ENABLE_KTLS
+  SSL *ssl = bufferevent_openssl_get_ssl(client->ssl.buffer);
+
+  /* straight from the page cache while nothing is queued in front */
+  if (BIO_get_ktls_send(SSL_get_wbio(ssl)) &&
+      _s_ssl_client_pending(client) == 0) {
+    ossl_ssize_t ret = SSL_sendfile(ssl, fd, offset, size, 0);
+
+    if (ret > 0) {
+      sent = ret;
+      client->stats.offloaded += sent;
+    } else {
+      ERR_clear_error();
+    }
+  }
+#endif
+
+  int ret = 0;
+  if (sent < size && evbuffer_add_file_segment(_s_ssl_client_output(client),
+      segment, sent, size - sent) < 0)
+    ret = -ENOMEM;
+  evbuffer_file_segment_free(segment);
+  if (ret == 0) {
+    _s_ssl_client_written(client, size);
+  } else if (sent > 0) {
+    /* the head of the file is already on the wire, the stream is broken */
+    daemon_log(LOG_ERR, "partial file sent on '%s'\n", client->name);
+    _s_ssl_client_abort(client->ssl.buffer, client, ret);
+  }
+  return ret;
+}
+
+int s_ssl_client_write_frame(struct s_ssl_client *client,
+  const struct s_ssl_frame *frame)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+  daemon_return_val_if_fail(frame, -EINVAL);
+  daemon_return_val_if_fail(frame->payload || !frame->size, -EINVAL);
+
+  uint8_t header[SSL_FRAME_HEADER_SIZE];
+  int ret = s_ssl_frame_encode(header, frame);
+  daemon_return_val_if_fail(ret == 0, ret);
+
+  struct iovec iov[] = {
+    { .iov_base = header, .iov_len = sizeof(header) },
+    { .iov_base = (void *)frame->payload, .iov_len = frame->size }
+  };
+  return s_ssl_client_writev(client, iov, 2);
+}
+
+int s_ssl_client_set_coalescing(struct s_ssl_client *client,
+  const struct s_ssl_coalescing *config)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+
+  if (client->coalescing.staging) {
+    _s_ssl_client_flush(client);
+    event_free(client->coalescing.flush);
+    evbuffer_free(client->coalescing.staging);
+    memset(&client->coalescing, 0, sizeof(client->coalescing));
+  }
+
+  if (!config)
+    return 0;
+
+  client->coalescing.threshold = config->bytes ? config->bytes :
+    SSL_COALESCING_THRESHOLD;
+  client->coalescing.delay.tv_sec = config->delay / 1000000;
+  client->coalescing.delay.tv_usec = config->delay % 1000000;
+  client->coalescing.flush = evtimer_new(s_loop_tolibevent(client->loop),
+    (event_callback_fn)_s_ssl_client_flush_cbk, client);
+  client->coalescing.staging = evbuffer_new();
+
+  if (!client->coalescing.flush || !client->coalescing.staging) {
+    if (client->coalescing.flush)
+      event_free(client->coalescing.flush);
+    if (client->coalescing.staging)
+      evbuffer_free(client->coalescing.staging);
+    memset(&client->coalescing, 0, sizeof(client->coalescing));
+    return -ENOMEM;
+  }
+  return 0;
+}
+
+int s_ssl_client_flush(struct s_ssl_client *client)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+
+  if (client->coalescing.staging)
+    _s_ssl_client_flush(client);
+  return 0;
+}
+
+int s_ssl_client_set_watermarks(struct s_ssl_client *client, size_t low,
+  size_t high)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+  daemon_return_val_if_fail(!high || low < high, -EINVAL);
+
+  client->backpressure.high = high;
+  client->backpressure.low = high ? low : 0;
+  if (client->ssl.buffer)
+    bufferevent_setwatermark(client->ssl.buffer, EV_WRITE,
+      client->backpressure.low, 0);
+
+  if (!high && client->backpressure.congested) {
+    client->backpressure.congested = 0;
+    if (client->funcs.congestion)
+      client->funcs.congestion(client->userdata, e_ssl_congestion_writable);
+  } else {
+    _s_ssl_client_congestion(client);
+  }
+  return 0;
+}
+
+int s_ssl_client_is_congested(const struct s_ssl_client *client)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+
+  return client->backpressure.congested;
+}
+
+size_t s_ssl_client_get_pending(struct s_ssl_client *client)
+{
+  daemon_return_val_if_fail(client, 0);
+
+  return _s_ssl_client_pending(client);
+}
+
+int s_ssl_client_get_stats(const struct s_ssl_client *client,
+  struct s_ssl_client_stats *stats)
+{
+  daemon_return_val_if_fail(client, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
+
+  *stats = client->stats;
+  return 0;
 }
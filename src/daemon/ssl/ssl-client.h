@@ -20,14 +20,52 @@
 
 # include <stdint.h>
 # include <event2/event.h>
-# include <netinet/in.h>
+# include <sys/socket.h>
+# include <sys/types.h>
+# include <sys/uio.h>
 
 # include "daemon-loop.h"
 # include "ssl/ssl.h"
 # include "ssl/ssl-packet.h"
+# include "ssl/ssl-session.h"
 
 struct s_ssl_client;
 
+/**
+ * @brief Write coalescing configuration. The writes are staged and moved to
+ * the ssl layer once per loop iteration, after @delay, or as soon as @bytes
+ * are staged, whichever comes first
+ */
+struct s_ssl_coalescing {
+  uint32_t bytes;
+  uint32_t delay;
+};
+
+/**
+ * @brief Output counters of a ssl client. @records counts the TLS application
+ * data records really emitted, to compare with the @messages written,
+ * @congestions the number of times the high watermark was crossed and
+ * @offloaded the bytes sent by the kernel straight from files
+ */
+struct s_ssl_client_stats {
+  uint64_t bytes;
+  uint64_t congestions;
+  uint64_t flushes;
+  uint64_t messages;
+  uint64_t offloaded;
+  uint64_t records;
+};
+
+/**
+ * @brief Release callback of a payload written by reference, called once the
+ * payload is sent (or dropped)
+ * @param [in] data: payload given to #s_ssl_client_write_reference
+ * @param [in] size: payload size
+ * @param [in] userdata: userdata given to #s_ssl_client_write_reference
+ */
+typedef void (*s_ssl_cleanup_cbk)(const void *data, size_t size,
+  void *userdata);
+
 /**
  * @brief Allocate a new ssl client
  * @param [in] loop: event loop base instance
@@ -45,14 +83,32 @@ struct s_ssl_client *s_ssl_client_new(struct s_loop *loop,
 void s_ssl_client_free(struct s_ssl_client *client);
 
 /**
- * @brief Attempt a client connection on the address given in parameter
+ * @brief Attempt a client connection on the addresses given in parameter.
+ * Several addresses, typically IPv6 and IPv4 ones, are raced (see #s_race)
+ * and the handshake runs on the first connected socket only
  * @param [in] client: client to connect
  * @param [in] certificate: certificate to authenticate
- * @param [in] dest: address and port information
+ * @param [in] dests: addresses and ports in preference order
+ * @param [in] count: number of addresses
  * @return 0 on success, an -errno value on error
  */
 int s_ssl_client_connect(struct s_ssl_client *client,
-  const char *certificate, const struct sockaddr_in *dest);
+  const char *certificate, const struct sockaddr_storage *dests,
+  uint32_t count);
+
+/**
+ * @brief Attach an accepted socket to a client and start the server side
+ * handshake, the connection callback is raised once it completes. On error,
+ * the error callback is raised too, as for a failed handshake
+ * @param [in] client: client to attach
+ * @param [in] certificate: certificate chain to authenticate
+ * @param [in] private_key: private key of the certificate
+ * @param [in] fd: accepted socket, closed with the client, left to the caller
+ * on error
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_accept(struct s_ssl_client *client, const char *certificate,
+  const char *private_key, evutil_socket_t fd);
 
 /**
  * @brief Set a name to the client interface
@@ -62,6 +118,47 @@ int s_ssl_client_connect(struct s_ssl_client *client,
  */
 int s_ssl_client_set_name(struct s_ssl_client *client, const char *name);
 
+/**
+ * @brief Perform the handshakes of a client on another loop than its own. The
+ * connection moves to the loop of the client once established, so a burst of
+ * handshakes does not delay the established connections. Nothing can be
+ * written before the connection callback
+ * @param [in] client: client to modify
+ * @param [in] loop: handshake loop, NULL to handshake on the loop of the client
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_set_handshake_loop(struct s_ssl_client *client,
+  struct s_loop *loop);
+
+/**
+ * @brief Let the kernel encrypt the records (kTLS) of the next connections of
+ * a client. The connections silently stay in userspace when the kernel or the
+ * negotiated cipher do not support it
+ * @param [in] client: client to modify
+ * @param [in] enable: 1 to enable, 0 to disable
+ * @return 0 on success, -ENOTSUP if the ssl library lacks kTLS, an -errno
+ * value on error
+ */
+int s_ssl_client_set_ktls(struct s_ssl_client *client, uint8_t enable);
+
+/**
+ * @brief Check if the records sent by a client are encrypted by the kernel
+ * @param [in] client: client to browse
+ * @return 1 if they are, 0 if not, an -errno value on error
+ */
+int s_ssl_client_is_ktls(const struct s_ssl_client *client);
+
+/**
+ * @brief Resume the handshakes of a client from a session cache, shared with
+ * the other clients. The session is looked up by name and destination
+ * address, so it must be set (as the name) before connecting
+ * @param [in] client: client to modify
+ * @param [in] cache: session cache, NULL to always perform a full handshake
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_set_session_cache(struct s_ssl_client *client,
+  struct s_ssl_sessions *cache);
+
 /**
  * @brief Write a packet in the socket
  * @param [in] socket: socket concerned by the packet
@@ -71,4 +168,104 @@ int s_ssl_client_set_name(struct s_ssl_client *client, const char *name);
 int s_ssl_client_write(struct s_ssl_client *client,
   const struct s_ssl_packet *packet);
 
+/**
+ * @brief Write several buffers in the socket at once. They are gathered with a
+ * single copy into the output buffer
+ * @param [in] client: client concerned by the buffers
+ * @param [in] iov: buffers to send
+ * @param [in] count: number of buffers
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_writev(struct s_ssl_client *client, const struct iovec *iov,
+  uint32_t count);
+
+/**
+ * @brief Write a payload in the socket without copying it. The payload must
+ * stay valid until @cleanup is called, which is also the case on error
+ * @param [in] client: client concerned by the payload
+ * @param [in] data: payload to send
+ * @param [in] size: payload size
+ * @param [in] cleanup: release callback
+ * @param [in] userdata: userdata given to @cleanup
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_write_reference(struct s_ssl_client *client,
+  const void *data, size_t size, s_ssl_cleanup_cbk cleanup, void *userdata);
+
+/**
+ * @brief Send a part of a file. With kTLS and nothing else queued, the kernel
+ * sends it from the page cache, otherwise it is mapped into the output buffer.
+ * @fd stays owned by the caller and can be closed once the call returns
+ * @param [in] client: client concerned by the file
+ * @param [in] fd: file to send
+ * @param [in] offset: first byte to send
+ * @param [in] size: number of bytes to send
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_sendfile(struct s_ssl_client *client, int fd, off_t offset,
+  size_t size);
+
+/**
+ * @brief Write a frame in the socket, header and payload are queued together
+ * @param [in] client: client concerned by the frame
+ * @param [in] frame: frame to send
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_write_frame(struct s_ssl_client *client,
+  const struct s_ssl_frame *frame);
+
+/**
+ * @brief Enable the write coalescing on a client
+ * @param [in] client: client to modify
+ * @param [in] config: coalescing configuration, @bytes defaults to a full TLS
+ * record when 0 and @delay is in microseconds. NULL disables the coalescing
+ * after flushing what is staged
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_set_coalescing(struct s_ssl_client *client,
+  const struct s_ssl_coalescing *config);
+
+/**
+ * @brief Flush the staged writes without waiting for the end of the loop
+ * iteration
+ * @param [in] client: client to flush
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_flush(struct s_ssl_client *client);
+
+/**
+ * @brief Bound the output queue of a client. Once @high bytes are waiting to
+ * be sent, the congestion callback is raised and every write is refused with
+ * -EAGAIN until the queue drains down to @low bytes
+ * @param [in] client: client to modify
+ * @param [in] low: low watermark, lower than @high
+ * @param [in] high: high watermark, 0 disables the backpressure
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_set_watermarks(struct s_ssl_client *client, size_t low,
+  size_t high);
+
+/**
+ * @brief Check if the producers of a client must pause
+ * @param [in] client: client to browse
+ * @return 1 if congested, 0 if writable, an -errno value on error
+ */
+int s_ssl_client_is_congested(const struct s_ssl_client *client);
+
+/**
+ * @brief Get the number of bytes waiting to be sent, staged ones included
+ * @param [in] client: client to browse
+ * @return the number of bytes
+ */
+size_t s_ssl_client_get_pending(struct s_ssl_client *client);
+
+/**
+ * @brief Get the output counters of a client
+ * @param [in] client: client to browse
+ * @param [out] stats: counters to fill
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_client_get_stats(const struct s_ssl_client *client,
+  struct s_ssl_client_stats *stats);
+
 #endif /* !_SSL_SSL_CLIENT_H_ */
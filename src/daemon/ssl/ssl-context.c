@@ -0,0 +1,168 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libdaemon/dlog.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-hash.h"
+#include "ssl/ssl.h"
+#include "ssl/ssl-context.h"
+
+/**
+ * @brief Registry entry, stored as app data of its context
+ */
+struct s_ssl_context {
+  SSL_CTX *context;
+  char *key;
+  uint32_t refs;
+};
+
+static struct s_hash *_g_ssl_contexts;
+static pthread_mutex_t _g_ssl_contexts_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t _g_ssl_library_refs;
+
+int s_ssl_library_init(void)
+{
+  if (_g_ssl_library_refs++ > 0)
+    return 0;
+
+  SSL_load_error_strings();
+  SSL_library_init();
+  if (!RAND_poll()) {
+    _g_ssl_library_refs = 0;
+    daemon_log(LOG_ERR, "failed to seed the ssl random generator\n");
+    return -EBADE;
+  }
+  _g_ssl_contexts = s_hash_new(NULL);
+  return 0;
+}
+
+void s_ssl_library_deinit(void)
+{
+  daemon_return_if_fail(_g_ssl_library_refs > 0);
+
+  if (--_g_ssl_library_refs > 0)
+    return;
+
+  if (s_hash_get_count(_g_ssl_contexts) > 0)
+    daemon_log(LOG_WARNING, "%u ssl contexts still referenced\n",
+      s_hash_get_count(_g_ssl_contexts));
+  s_hash_free(_g_ssl_contexts);
+  _g_ssl_contexts = NULL;
+  s_ssl_context_deinit();
+}
+
+/**
+ * @brief Reference the context of a key, or register a new one
+ * @param [in] key: registry key
+ * @param [in] certificate: certificate chain path
+ * @param [in] private_key: private key path, NULL for a client context
+ * @param [in] new_session: new session callback of a client context
+ * @return a referenced context on success, NULL on error
+ */
+static SSL_CTX *_s_ssl_context_get(const char *key, const char *certificate,
+  const char *private_key, s_ssl_session_cbk new_session)
+{
+  daemon_return_val_if_fail(_g_ssl_contexts, NULL);
+
+  SSL_CTX *context = NULL;
+
+  pthread_mutex_lock(&_g_ssl_contexts_lock);
+  struct s_ssl_context *entry = s_hash_lookup(_g_ssl_contexts, key);
+  if (entry) {
+    entry->refs++;
+    context = entry->context;
+    goto unlock;
+  }
+
+  context = private_key ?
+    s_ssl_context_server_new(certificate, private_key) :
+    s_ssl_context_client_new(certificate);
+  if (!context)
+    goto unlock;
+
+  /* shared by every client afterwards, only configured here */
+  if (!private_key) {
+    SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT |
+      SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(context, new_session);
+  }
+
+  entry = daemon_malloc(sizeof(struct s_ssl_context));
+  entry->context = context;
+  entry->key = strdup(key);
+  entry->refs = 1;
+  SSL_CTX_set_app_data(context, entry);
+  s_hash_insert(_g_ssl_contexts, key, entry);
+
+unlock:
+  pthread_mutex_unlock(&_g_ssl_contexts_lock);
+  return context;
+}
+
+SSL_CTX *s_ssl_context_client_get(const char *certificate,
+  s_ssl_session_cbk new_session)
+{
+  daemon_return_val_if_fail(certificate, NULL);
+
+  size_t size = strlen(certificate) + 8;
+  char *key = daemon_malloc(size);
+  snprintf(key, size, "client:%s", certificate);
+
+  SSL_CTX *context = _s_ssl_context_get(key, certificate, NULL,
+    new_session);
+  daemon_free(key);
+  return context;
+}
+
+SSL_CTX *s_ssl_context_server_get(const char *certificate,
+  const char *private_key)
+{
+  daemon_return_val_if_fail(certificate, NULL);
+  daemon_return_val_if_fail(private_key, NULL);
+
+  size_t size = strlen(certificate) + strlen(private_key) + 9;
+  char *key = daemon_malloc(size);
+  snprintf(key, size, "server:%s:%s", certificate, private_key);
+
+  SSL_CTX *context = _s_ssl_context_get(key, certificate, private_key,
+    NULL);
+  daemon_free(key);
+  return context;
+}
+
+void s_ssl_context_put(SSL_CTX *context)
+{
+  daemon_return_if_fail(context);
+
+  struct s_ssl_context *entry = SSL_CTX_get_app_data(context);
+  daemon_return_if_fail(entry);
+
+  pthread_mutex_lock(&_g_ssl_contexts_lock);
+  uint32_t refs = --entry->refs;
+  if (refs == 0 && _g_ssl_contexts)
+    s_hash_remove(_g_ssl_contexts, entry->key);
+  pthread_mutex_unlock(&_g_ssl_contexts_lock);
+  if (refs > 0)
+    return;
+
+  SSL_CTX_free(entry->context);
+  daemon_free(entry->key);
+  daemon_free(entry);
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SSL_SSL_CONTEXT_H_
+# define _SSL_SSL_CONTEXT_H_
+
+# include <openssl/ssl.h>
+
+/**
+ * @brief Initialize the ssl library, only the first call does the work. Each
+ * call must be balanced by #s_ssl_library_deinit
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_library_init(void);
+
+/**
+ * @brief Release the ssl library, the last call cleans the openssl state up
+ * once every context has been released
+ */
+void s_ssl_library_deinit(void);
+
+/**
+ * @brief Release a context reference, the context is freed with the last one
+ * @param [in] context: context given by #s_ssl_context_client_get or
+ * #s_ssl_context_server_get
+ */
+void s_ssl_context_put(SSL_CTX *context);
+
+/**
+ * @brief New session callback of the client contexts, see
+ * SSL_CTX_sess_set_new_cb
+ * @param [in] ssl: connection receiving the session
+ * @param [in] session: new session
+ * @return 1 if the session reference is kept, 0 otherwise
+ */
+typedef int (*s_ssl_session_cbk)(struct ssl_st *ssl,
+  struct ssl_session_st *session);
+
+/**
+ * @brief Get the shared client context of a certificate chain, which is only
+ * loaded on the first request. The context caches its sessions externally
+ * only, through @new_session, configured once when it is created
+ * @param [in] certificate: certificate chain path
+ * @param [in] new_session: new session callback
+ * @return a referenced context to release with #s_ssl_context_put on success,
+ * NULL on error
+ */
+SSL_CTX *s_ssl_context_client_get(const char *certificate,
+  s_ssl_session_cbk new_session);
+
+/**
+ * @brief Get the shared server context of a certificate chain and its
+ * private key, which are only loaded on the first request
+ * @param [in] certificate: certificate chain path
+ * @param [in] private_key: private key path
+ * @return a referenced context to release with #s_ssl_context_put on success,
+ * NULL on error
+ */
+SSL_CTX *s_ssl_context_server_get(const char *certificate,
+  const char *private_key);
+
+#endif /* !_SSL_SSL_CONTEXT_H_ */
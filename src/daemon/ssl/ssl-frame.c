@@ -0,0 +1,51 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <libdaemon/dlog.h>
+#include <string.h>
+#include "daemon-cond.h"
+#include "ssl/ssl-frame.h"
+
+int s_ssl_frame_decode(const uint8_t *header, struct s_ssl_frame *frame)
+{
+  daemon_return_val_if_fail(header, -EINVAL);
+  daemon_return_val_if_fail(frame, -EINVAL);
+
+  uint32_t size = 0;
+  memcpy(&size, header + 2, sizeof(uint32_t));
+
+  frame->type = header[0];
+  frame->flags = header[1];
+  frame->size = ntohl(size);
+  frame->payload = NULL;
+  return frame->size > SSL_FRAME_MAX_SIZE ? -EMSGSIZE : 0;
+}
+
+int s_ssl_frame_encode(uint8_t *header, const struct s_ssl_frame *frame)
+{
+  daemon_return_val_if_fail(header, -EINVAL);
+  daemon_return_val_if_fail(frame, -EINVAL);
+  daemon_return_val_if_fail(frame->size <= SSL_FRAME_MAX_SIZE, -EMSGSIZE);
+
+  uint32_t size = htonl(frame->size);
+
+  header[0] = frame->type;
+  header[1] = frame->flags;
+  memcpy(header + 2, &size, sizeof(uint32_t));
+  return 0;
+}
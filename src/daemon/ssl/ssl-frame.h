@@ -0,0 +1,61 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SSL_SSL_FRAME_H_
+# define _SSL_SSL_FRAME_H_
+
+# include <stdint.h>
+
+/**
+ * @brief Size of the frame header on the wire: type (1 byte), flags (1 byte)
+ * and payload length (4 bytes, network order)
+ */
+# define SSL_FRAME_HEADER_SIZE 6
+
+/**
+ * @brief Biggest payload accepted for a frame, a bigger length is considered
+ * as a corrupted stream
+ */
+# define SSL_FRAME_MAX_SIZE (16 * 1024 * 1024)
+
+/**
+ * @brief Length-prefixed message exchanged between two ssl clients
+ */
+struct s_ssl_frame {
+  uint8_t type;
+  uint8_t flags;
+  uint32_t size;
+  const uint8_t *payload;
+};
+
+/**
+ * @brief Decode a frame header, the payload is not set
+ * @param [in] header: SSL_FRAME_HEADER_SIZE bytes to decode
+ * @param [out] frame: frame to fill
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_frame_decode(const uint8_t *header, struct s_ssl_frame *frame);
+
+/**
+ * @brief Encode a frame header
+ * @param [out] header: SSL_FRAME_HEADER_SIZE bytes to fill
+ * @param [in] frame: frame to encode, the payload is ignored
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_frame_encode(uint8_t *header, const struct s_ssl_frame *frame);
+
+#endif /* !_SSL_SSL_FRAME_H_ */
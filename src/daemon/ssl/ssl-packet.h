@@ -27,6 +27,21 @@ struct s_ssl_packet {
   uint32_t size;
 };
 
+/**
+ * @brief Allocate a ssl packet instance, the payload is filled by the caller.
+ * The packet and its payload share a single block from the loop pool
+ * @param [in] size: payload's size to allocate
+ * @return a valid pointer on success, NULL on error
+ */
+static inline struct s_ssl_packet *s_ssl_packet_alloc(uint32_t size)
+{
+  struct s_ssl_packet *packet = daemon_pool_alloc(sizeof(struct s_ssl_packet) +
+    sizeof(uint8_t) * size);
+  packet->payload = (uint8_t *)(packet + 1);
+  packet->size = size;
+  return packet;
+}
+
 /**
  * @brief Allocate a ssl packet instance
  * @param [in] payload: data payload to store
@@ -38,10 +53,8 @@ static inline struct s_ssl_packet *s_ssl_packet_new(const uint8_t *payload,
 {
   daemon_return_val_if_fail(payload, NULL);
 
-  struct s_ssl_packet *packet = daemon_malloc(sizeof(struct s_ssl_packet));
-  packet->payload = daemon_malloc(sizeof(uint8_t) * size);
+  struct s_ssl_packet *packet = s_ssl_packet_alloc(size);
   memcpy(packet->payload, payload, size);
-  packet->size = size;
   return packet;
 }
 
@@ -53,8 +66,7 @@ static inline void s_ssl_packet_free(struct s_ssl_packet *packet)
 {
   daemon_return_if_fail(packet);
 
-  daemon_free(packet->payload);
-  daemon_free(packet);
+  daemon_pool_free(packet);
 }
 
 #endif /* !_SSL_SSL_PACKET_H_ */
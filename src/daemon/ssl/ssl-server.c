@@ -0,0 +1,178 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <event2/listener.h>
+#include <libdaemon/dlog.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include "daemon-address.h"
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "ssl/ssl-context.h"
+#include "ssl/ssl-server.h"
+
+struct s_ssl_server {
+  s_ssl_accept_cbk accept;
+  char *certificate;
+  SSL_CTX *context;
+  struct evconnlistener *listener;
+  struct s_loop *loop;
+  char *private_key;
+  void *userdata;
+};
+
+/**
+ * @brief Listener callback, called for every accepted socket
+ * @param [in] listener: listener of the server
+ * @param [in] fd: accepted socket
+ * @param [in] address: remote address
+ * @param [in] size: remote address size
+ * @param [in] server: ssl server representation
+ */
+static void _s_ssl_server_accept(daemon_unused struct evconnlistener *listener,
+  evutil_socket_t fd, struct sockaddr *address, int size,
+  struct s_ssl_server *server)
+{
+  daemon_return_if_fail(server);
+
+  struct s_ssl_client *client = NULL;
+  struct sockaddr_storage remote = { 0, };
+  if (size > 0 && (size_t)size <= sizeof(remote))
+    memcpy(&remote, address, size);
+  socklen_t expected = s_address_get_size(&remote);
+  if (expected && size >= (int)expected)
+    client = server->accept(server->userdata, server->loop, &remote);
+
+  if (!client) {
+    close(fd);
+    return;
+  }
+
+  /* the client reported the failure to its owner, only the socket is left */
+  if (s_ssl_client_accept(client, server->certificate, server->private_key,
+      fd) < 0) {
+    daemon_log(LOG_ERR, "failed to accept an ssl connection\n");
+    close(fd);
+  }
+}
+
+/**
+ * @brief Listener error callback, the listener keeps running
+ * @param [in] listener: listener of the server
+ * @param [in] server: ssl server representation
+ */
+static void _s_ssl_server_error(daemon_unused struct evconnlistener *listener,
+  daemon_unused struct s_ssl_server *server)
+{
+  daemon_log(LOG_ERR, "ssl server failed to accept '%s'\n",
+    strerror(EVUTIL_SOCKET_ERROR()));
+}
+
+/**
+ * @brief Create a bound listening socket. The options are set before the bind,
+ * an IPv6 socket accepts the IPv4 connections too whatever the system default
+ * @param [in] address: IPv4 or IPv6 address and port to bind
+ * @param [in] size: size of @address
+ * @return a valid socket on success, an -errno value on error
+ */
+static evutil_socket_t _s_ssl_server_socket(
+  const struct sockaddr_storage *address, socklen_t size)
+{
+  int off = 0;
+  evutil_socket_t fd = socket(address->ss_family,
+    SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -errno;
+
+  if (evutil_make_listen_socket_reuseable(fd) < 0 ||
+      evutil_make_listen_socket_reuseable_port(fd) < 0 ||
+      (address->ss_family == AF_INET6 && setsockopt(fd, IPPROTO_IPV6,
+        IPV6_V6ONLY, &off, sizeof(off)) < 0) ||
+      bind(fd, (const struct sockaddr *)address, size) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    int ret = -errno;
+    evutil_closesocket(fd);
+    return ret;
+  }
+  return fd;
+}
+
+struct s_ssl_server *s_ssl_server_new(struct s_loop *loop,
+  const char *certificate, const char *private_key, s_ssl_accept_cbk accept,
+  void *userdata)
+{
+  daemon_return_val_if_fail(loop, NULL);
+  daemon_return_val_if_fail(certificate, NULL);
+  daemon_return_val_if_fail(private_key, NULL);
+  daemon_return_val_if_fail(accept, NULL);
+
+  SSL_CTX *context = s_ssl_context_server_get(certificate, private_key);
+  daemon_return_val_if_fail(context, NULL);
+
+  struct s_ssl_server *server = daemon_zalloc(sizeof(struct s_ssl_server));
+  server->accept = accept;
+  server->certificate = strdup(certificate);
+  server->context = context;
+  server->loop = loop;
+  server->private_key = strdup(private_key);
+  server->userdata = userdata;
+  return server;
+}
+
+void s_ssl_server_free(struct s_ssl_server *server)
+{
+  daemon_return_if_fail(server);
+
+  if (server->listener)
+    evconnlistener_free(server->listener);
+  s_ssl_context_put(server->context);
+  daemon_free(server->certificate);
+  daemon_free(server->private_key);
+  daemon_free(server);
+}
+
+int s_ssl_server_listen(struct s_ssl_server *server,
+  const struct sockaddr_storage *address)
+{
+  daemon_return_val_if_fail(server, -EINVAL);
+  daemon_return_val_if_fail(address, -EINVAL);
+  daemon_return_val_if_fail(!server->listener, -EALREADY);
+
+  socklen_t size = s_address_get_size(address);
+  daemon_return_val_if_fail(size, -EAFNOSUPPORT);
+
+  evutil_socket_t fd = _s_ssl_server_socket(address, size);
+  if (fd >= 0) {
+    uint32_t flags = LEV_OPT_CLOSE_ON_FREE | LEV_OPT_CLOSE_ON_EXEC;
+    server->listener = evconnlistener_new(s_loop_tolibevent(server->loop),
+      (evconnlistener_cb)_s_ssl_server_accept, server, flags, -1, fd);
+    if (!server->listener)
+      evutil_closesocket(fd);
+  }
+  if (!server->listener) {
+    int ret = fd < 0 ? fd : -EBADE;
+    char str[ADDRESS_STR_MAX];
+    s_address_to_string(address, str, sizeof(str));
+    daemon_log(LOG_ERR, "failed to listen on %s '%s'\n", str,
+      strerror(-ret));
+    return ret;
+  }
+
+  evconnlistener_set_error_cb(server->listener,
+    (evconnlistener_errorcb)_s_ssl_server_error);
+  return 0;
+}
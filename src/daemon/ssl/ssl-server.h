@@ -0,0 +1,76 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SSL_SSL_SERVER_H_
+# define _SSL_SSL_SERVER_H_
+
+# include <sys/socket.h>
+
+# include "daemon-loop.h"
+# include "ssl/ssl-client.h"
+
+/**
+ * @brief Accept callback, called for every inbound connection before its
+ * handshake. The application allocates the client (and so chooses its
+ * callbacks and userdata), it owns it afterwards
+ * @param [in] userdata: userdata given to #s_ssl_server_new
+ * @param [in] loop: loop of the server, the client must be allocated on it
+ * @param [in] address: IPv4 or IPv6 address of the remote peer
+ * @return a client without connection on success, NULL to refuse the peer
+ */
+typedef struct s_ssl_client *(*s_ssl_accept_cbk)(void *userdata,
+  struct s_loop *loop, const struct sockaddr_storage *address);
+
+/**
+ * @brief TLS listener, accepts the inbound connections of a s_loop
+ */
+struct s_ssl_server;
+
+/**
+ * @brief Allocate a new ssl server, the certificate and its key are loaded
+ * once and shared with every accepted connection
+ * @param [in] loop: event loop base instance
+ * @param [in] certificate: certificate chain to authenticate
+ * @param [in] private_key: private key of the certificate
+ * @param [in] accept: accept callback
+ * @param [in] userdata: userdata given to @accept
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_ssl_server *s_ssl_server_new(struct s_loop *loop,
+  const char *certificate, const char *private_key, s_ssl_accept_cbk accept,
+  void *userdata);
+
+/**
+ * @brief Deallocate a specific ssl server, the accepted clients are kept
+ * @param [in] server: server to delete
+ */
+void s_ssl_server_free(struct s_ssl_server *server);
+
+/**
+ * @brief Start listening on an address. The socket is bound with
+ * SO_REUSEPORT: the servers of several loops listen on the same port and the
+ * kernel spreads the incoming connections between them. An IPv6 wildcard
+ * address accepts the IPv4 connections too, even if the system binds IPv6
+ * only by default
+ * @param [in] server: server to start
+ * @param [in] address: IPv4 or IPv6 address and port to bind
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_server_listen(struct s_ssl_server *server,
+  const struct sockaddr_storage *address);
+
+#endif /* !_SSL_SSL_SERVER_H_ */
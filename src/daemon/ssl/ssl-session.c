@@ -0,0 +1,126 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libdaemon/dlog.h>
+#include <time.h>
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "daemon-hash.h"
+#include "ssl/ssl-session.h"
+
+struct s_ssl_sessions {
+  struct s_hash *hash;
+  struct s_ssl_session_stats stats;
+};
+
+/**
+ * @brief Check if a session can still be offered to the server
+ * @param [in] session: session to check
+ * @return 1 if resumable, 0 otherwise
+ */
+static int _s_ssl_session_is_valid(const SSL_SESSION *session)
+{
+  time_t expiration = SSL_SESSION_get_time(session) +
+    SSL_SESSION_get_timeout(session);
+
+  return SSL_SESSION_is_resumable(session) && time(NULL) < expiration;
+}
+
+struct s_ssl_sessions *s_ssl_sessions_new(void)
+{
+  struct s_ssl_sessions *cache = daemon_zalloc(sizeof(struct s_ssl_sessions));
+  cache->hash = s_hash_new((s_hash_free_cbk)SSL_SESSION_free);
+  return cache;
+}
+
+void s_ssl_sessions_free(struct s_ssl_sessions *cache)
+{
+  daemon_return_if_fail(cache);
+
+  s_hash_free(cache->hash);
+  daemon_free(cache);
+}
+
+int s_ssl_sessions_resume(struct s_ssl_sessions *cache,
+  struct ssl_st *ssl, const char *key)
+{
+  daemon_return_val_if_fail(cache, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+  daemon_return_val_if_fail(ssl, -EINVAL);
+
+  SSL_SESSION *session = s_hash_lookup(cache->hash, key);
+  if (session && !_s_ssl_session_is_valid(session)) {
+    s_hash_remove(cache->hash, key);
+    cache->stats.expired++;
+    session = NULL;
+  }
+
+  if (!session || !SSL_set_session(ssl, session)) {
+    cache->stats.misses++;
+    return 0;
+  }
+  cache->stats.hits++;
+  return 1;
+}
+
+int s_ssl_sessions_put(struct s_ssl_sessions *cache,
+  struct ssl_session_st *session, const char *key)
+{
+  daemon_return_val_if_fail(cache, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+  daemon_return_val_if_fail(session, -EINVAL);
+
+  /* the reference given is an additional one on the stored session */
+  if (s_hash_lookup(cache->hash, key) == session) {
+    SSL_SESSION_free(session);
+    return 0;
+  }
+
+  s_hash_remove(cache->hash, key);
+  int ret = s_hash_insert(cache->hash, key, session);
+  if (ret == 0)
+    cache->stats.stores++;
+  return ret;
+}
+
+int s_ssl_sessions_remove(struct s_ssl_sessions *cache, const char *key)
+{
+  daemon_return_val_if_fail(cache, -EINVAL);
+  daemon_return_val_if_fail(key, -EINVAL);
+
+  return s_hash_remove(cache->hash, key);
+}
+
+void s_ssl_sessions_handshake(struct s_ssl_sessions *cache, int resumed)
+{
+  daemon_return_if_fail(cache);
+
+  if (resumed)
+    cache->stats.resumed++;
+  else
+    cache->stats.full++;
+}
+
+int s_ssl_sessions_get_stats(const struct s_ssl_sessions *cache,
+  struct s_ssl_session_stats *stats)
+{
+  daemon_return_val_if_fail(cache, -EINVAL);
+  daemon_return_val_if_fail(stats, -EINVAL);
+
+  *stats = cache->stats;
+  return 0;
+}
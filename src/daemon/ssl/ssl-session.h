@@ -0,0 +1,102 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SSL_SSL_SESSION_H_
+# define _SSL_SSL_SESSION_H_
+
+# include <openssl/ssl.h>
+# include <stdint.h>
+
+/**
+ * @brief Counters of a session cache. @hits and @misses are counted when a
+ * connection looks for a session to offer, @resumed and @full when the
+ * handshake completes: a hit not followed by a resumption means the server
+ * refused the session
+ */
+struct s_ssl_session_stats {
+  uint64_t expired;
+  uint64_t full;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t resumed;
+  uint64_t stores;
+};
+
+/**
+ * @brief Client side cache of the TLS sessions (and TLS 1.3 tickets), keyed by
+ * peer identity, used to resume the handshake of a reconnection
+ */
+struct s_ssl_sessions;
+
+/**
+ * @brief Allocate a new session cache
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_ssl_sessions *s_ssl_sessions_new(void);
+
+/**
+ * @brief Deallocate a specific session cache and release every session
+ * @param [in] cache: cache to delete
+ */
+void s_ssl_sessions_free(struct s_ssl_sessions *cache);
+
+/**
+ * @brief Offer the session of a peer to a connection before its handshake, an
+ * expired session is dropped
+ * @param [in] cache: cache to browse
+ * @param [in] ssl: connection to resume
+ * @param [in] key: peer identity
+ * @return 1 if a session is offered, 0 if none, an -errno value on error
+ */
+int s_ssl_sessions_resume(struct s_ssl_sessions *cache,
+  struct ssl_st *ssl, const char *key);
+
+/**
+ * @brief Store the session of a peer, replacing the previous one
+ * @param [in] cache: cache to modify
+ * @param [in] session: session to store, the cache takes over the reference
+ * @param [in] key: peer identity
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_sessions_put(struct s_ssl_sessions *cache,
+  struct ssl_session_st *session, const char *key);
+
+/**
+ * @brief Forget the session of a peer, typically after a failed handshake
+ * @param [in] cache: cache to modify
+ * @param [in] key: peer identity
+ * @return 0 on success, -ENOENT if unknown, an -errno value on error
+ */
+int s_ssl_sessions_remove(struct s_ssl_sessions *cache, const char *key);
+
+/**
+ * @brief Account a completed handshake
+ * @param [in] cache: cache to modify
+ * @param [in] resumed: 1 if the session was resumed, 0 for a full handshake
+ */
+void s_ssl_sessions_handshake(struct s_ssl_sessions *cache, int resumed);
+
+/**
+ * @brief Get the counters of a cache
+ * @param [in] cache: cache to browse
+ * @param [out] stats: counters to fill
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_sessions_get_stats(const struct s_ssl_sessions *cache,
+  struct s_ssl_session_stats *stats);
+
+#endif /* !_SSL_SSL_SESSION_H_ */
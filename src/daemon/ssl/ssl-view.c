@@ -0,0 +1,153 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <libdaemon/dlog.h>
+#include "daemon-alloc.h"
+#include "daemon-cond.h"
+#include "ssl/ssl-view.h"
+
+int s_ssl_view_map(struct s_ssl_view *view, struct evbuffer *buffer)
+{
+  daemon_return_val_if_fail(view, -EINVAL);
+  daemon_return_val_if_fail(buffer, -EINVAL);
+
+  int count = evbuffer_peek(buffer, -1, NULL, NULL, 0);
+  daemon_return_val_if_fail(count >= 0, -EBADE);
+
+  /* the segment storage only grows, its content is refilled by the peek */
+  if ((uint32_t)count > view->capacity) {
+    if (view->segments)
+      daemon_free(view->segments);
+    view->segments = daemon_malloc(sizeof(struct evbuffer_iovec) * count);
+    view->capacity = count;
+  }
+
+  view->buffer = buffer;
+  view->count = evbuffer_peek(buffer, -1, NULL, view->segments, count);
+  view->first = 0;
+  view->consumed = 0;
+  view->size = evbuffer_get_length(buffer);
+  return 0;
+}
+
+int s_ssl_view_unmap(struct s_ssl_view *view)
+{
+  daemon_return_val_if_fail(view, -EINVAL);
+  daemon_return_val_if_fail(view->buffer, -EINVAL);
+
+  size_t consumed = view->consumed;
+  int ret = consumed ? evbuffer_drain(view->buffer, consumed) : 0;
+
+  view->buffer = NULL;
+  view->count = 0;
+  view->first = 0;
+  view->consumed = 0;
+  view->size = 0;
+  return ret < 0 ? -EBADE : (int)consumed;
+}
+
+void s_ssl_view_clear(struct s_ssl_view *view)
+{
+  daemon_return_if_fail(view);
+
+  if (view->segments)
+    daemon_free(view->segments);
+  view->segments = NULL;
+  view->capacity = 0;
+}
+
+size_t s_ssl_view_get_size(const struct s_ssl_view *view)
+{
+  daemon_return_val_if_fail(view, 0);
+
+  return view->size - view->consumed;
+}
+
+uint32_t s_ssl_view_get_count(const struct s_ssl_view *view)
+{
+  daemon_return_val_if_fail(view, 0);
+
+  return view->count - view->first;
+}
+
+int s_ssl_view_get_segment(const struct s_ssl_view *view, uint32_t index,
+  const uint8_t **data, size_t *size)
+{
+  daemon_return_val_if_fail(view, -EINVAL);
+  daemon_return_val_if_fail(data, -EINVAL);
+  daemon_return_val_if_fail(size, -EINVAL);
+  daemon_return_val_if_fail(index < s_ssl_view_get_count(view), -ERANGE);
+
+  const struct evbuffer_iovec *segment = &view->segments[view->first + index];
+  *data = segment->iov_base;
+  *size = segment->iov_len;
+  return 0;
+}
+
+int s_ssl_view_consume(struct s_ssl_view *view, size_t size)
+{
+  daemon_return_val_if_fail(view, -EINVAL);
+  daemon_return_val_if_fail(size <= s_ssl_view_get_size(view), -ERANGE);
+
+  view->consumed += size;
+  /* move the first segment forward so the view only exposes what remains */
+  while (size > 0) {
+    struct evbuffer_iovec *segment = &view->segments[view->first];
+    if (size < segment->iov_len) {
+      segment->iov_base = (uint8_t *)segment->iov_base + size;
+      segment->iov_len -= size;
+      break;
+    }
+    size -= segment->iov_len;
+    view->first++;
+  }
+  return 0;
+}
+
+size_t s_ssl_view_copy(const struct s_ssl_view *view, size_t offset,
+  uint8_t *data, size_t size)
+{
+  daemon_return_val_if_fail(view, 0);
+  daemon_return_val_if_fail(data, 0);
+
+  size_t copied = 0;
+  for (uint32_t i = view->first; i < view->count && copied < size; ++i) {
+    const struct evbuffer_iovec *segment = &view->segments[i];
+    if (offset >= segment->iov_len) {
+      offset -= segment->iov_len;
+      continue;
+    }
+    size_t length = segment->iov_len - offset;
+    if (length > size - copied)
+      length = size - copied;
+    memcpy(data + copied, (uint8_t *)segment->iov_base + offset, length);
+    copied += length;
+    offset = 0;
+  }
+  return copied;
+}
+
+struct s_ssl_packet *s_ssl_view_packet_new(const struct s_ssl_view *view,
+  size_t size)
+{
+  daemon_return_val_if_fail(view, NULL);
+  daemon_return_val_if_fail(size <= s_ssl_view_get_size(view), NULL);
+
+  struct s_ssl_packet *packet = s_ssl_packet_alloc(size);
+  s_ssl_view_copy(view, 0, packet->payload, size);
+  return packet;
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of cerebellum.
+ *
+ * cerebellum is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * cerebellum is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cerebellum.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SSL_SSL_VIEW_H_
+# define _SSL_SSL_VIEW_H_
+
+# include <stddef.h>
+# include <stdint.h>
+# include <event2/buffer.h>
+
+# include "ssl/ssl-packet.h"
+
+/**
+ * @brief Zero-copy view over the input chain of a ssl client.
+ * The segments point directly inside the bufferevent input buffer and are only
+ * valid during the read callback. Bytes marked as consumed are drained when
+ * the callback returns, the other ones are retained inside the input buffer
+ * and presented again (followed by the new data) on the next read callback.
+ */
+struct s_ssl_view {
+  struct evbuffer *buffer;
+  struct evbuffer_iovec *segments;
+  uint32_t capacity;
+  uint32_t count;
+  uint32_t first;
+  size_t consumed;
+  size_t size;
+};
+
+/**
+ * @brief Map a view on the current content of an input buffer
+ * @param [in] view: view to fill, the segment storage is reused between calls
+ * @param [in] buffer: input buffer to map
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_view_map(struct s_ssl_view *view, struct evbuffer *buffer);
+
+/**
+ * @brief Drain the consumed bytes from the mapped buffer and unmap the view
+ * @param [in] view: view to release
+ * @return the number of bytes drained on success, an -errno value on error
+ */
+int s_ssl_view_unmap(struct s_ssl_view *view);
+
+/**
+ * @brief Deallocate the segment storage of a view
+ * @param [in] view: view to clear
+ */
+void s_ssl_view_clear(struct s_ssl_view *view);
+
+/**
+ * @brief Get the number of bytes available through the view
+ * @param [in] view: view to browse
+ * @return the number of bytes not consumed yet
+ */
+size_t s_ssl_view_get_size(const struct s_ssl_view *view);
+
+/**
+ * @brief Get the number of segments of the view not consumed yet
+ * @param [in] view: view to browse
+ * @return the number of segments
+ */
+uint32_t s_ssl_view_get_count(const struct s_ssl_view *view);
+
+/**
+ * @brief Get a segment of the view without any copy
+ * @param [in] view: view to browse
+ * @param [in] index: segment index, lower than #s_ssl_view_get_count
+ * @param [out] data: segment start
+ * @param [out] size: segment size
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_view_get_segment(const struct s_ssl_view *view, uint32_t index,
+  const uint8_t **data, size_t *size);
+
+/**
+ * @brief Mark bytes as consumed, they will be drained when the read callback
+ * returns. Everything not consumed is retained for the next read callback
+ * @param [in] view: view to modify
+ * @param [in] size: number of bytes consumed from the view start
+ * @return 0 on success, an -errno value on error
+ */
+int s_ssl_view_consume(struct s_ssl_view *view, size_t size);
+
+/**
+ * @brief Copy bytes out of the view, the view is not modified
+ * @param [in] view: view to browse
+ * @param [in] offset: offset from the first unconsumed byte
+ * @param [out] data: destination buffer
+ * @param [in] size: number of bytes to copy
+ * @return the number of bytes copied
+ */
+size_t s_ssl_view_copy(const struct s_ssl_view *view, size_t offset,
+  uint8_t *data, size_t size);
+
+/**
+ * @brief Duplicate the first bytes of the view into a packet, for consumers
+ * that need to keep the payload after the read callback
+ * @param [in] view: view to browse
+ * @param [in] size: number of bytes to duplicate
+ * @return a valid pointer on success, NULL on error
+ */
+struct s_ssl_packet *s_ssl_view_packet_new(const struct s_ssl_view *view,
+  size_t size);
+
+#endif /* !_SSL_SSL_VIEW_H_ */
@@ -26,7 +26,9 @@
 # include <openssl/ssl.h>
 # include <stdint.h>
 
+# include "ssl-frame.h"
 # include "ssl-packet.h"
+# include "ssl-view.h"
 
 enum e_ssl_connection {
   e_ssl_connection_close,
@@ -34,6 +36,11 @@ enum e_ssl_connection {
   e_ssl_connection_timeout
 };
 
+enum e_ssl_congestion {
+  e_ssl_congestion_congested,
+  e_ssl_congestion_writable
+};
+
 enum e_ssl_error {
   e_ssl_error_connection,
   e_ssl_error_eof,
@@ -49,6 +56,16 @@ enum e_ssl_error {
 typedef void (*s_ssl_connection_cbk)(void *userdata,
   enum e_ssl_connection state);
 
+/**
+ * @brief Congestion status callback, called when the pending output crosses
+ * the high watermark (the producer must pause, the writes are refused) and
+ * when it drains back below the low watermark (the producer can resume)
+ * @param [in] userdata: userdata passing through the allocator
+ * @param [in] state: current congestion status
+ */
+typedef void (*s_ssl_congestion_cbk)(void *userdata,
+  enum e_ssl_congestion state);
+
 /**
  * @brief Error status callback, called whenever a read / write operation
  * failed
@@ -68,13 +85,36 @@ typedef void (*s_ssl_error_cbk)(void *userdata, enum e_ssl_error type,
 typedef void (*s_ssl_read_cbk)(void *userdata,
   const struct s_ssl_packet *packet);
 
+/**
+ * @brief Zero-copy read callback, called whenever data is received. The view
+ * maps the input buffer without any copy and is only valid during the call.
+ * When set, it replaces the @s_ssl_read_cbk callback
+ * @param [in] userdata: userdata passing through the allocator
+ * @param [in] view: view over the received data
+ */
+typedef void (*s_ssl_view_cbk)(void *userdata, struct s_ssl_view *view);
+
+/**
+ * @brief Frame callback, called once per complete frame received. Several
+ * frames can be delivered in a row for a single wakeup. The payload is only
+ * valid during the call. When set, it replaces the @s_ssl_view_cbk and
+ * @s_ssl_read_cbk callbacks
+ * @param [in] userdata: userdata passing through the allocator
+ * @param [in] frame: frame received
+ */
+typedef void (*s_ssl_frame_cbk)(void *userdata,
+  const struct s_ssl_frame *frame);
+
 /**
  * @brief Ssl socket behavior callback
  */
 struct s_ssl_funcs {
+  s_ssl_congestion_cbk congestion;
   s_ssl_connection_cbk connection;
   s_ssl_error_cbk error;
+  s_ssl_frame_cbk frame;
   s_ssl_read_cbk read;
+  s_ssl_view_cbk view;
 };
 
 /**
@@ -87,12 +127,14 @@ static inline int s_ssl_funcs_check(const struct s_ssl_funcs *funcs)
   daemon_return_val_if_fail(funcs, -EINVAL);
   daemon_return_val_if_fail(funcs->connection, -EBADE);
   daemon_return_val_if_fail(funcs->error, -EBADE);
-  daemon_return_val_if_fail(funcs->read, -EBADE);
+  daemon_return_val_if_fail(funcs->frame || funcs->read || funcs->view,
+    -EBADE);
   return 0;
 }
 
 /**
- * @brief Create a client openssl context
+ * @brief Create a server openssl context, the library must be initialized.
+ * Prefer the shared contexts of ssl-context.h
  * @param certificate: certificate path file
  * @param private_key: private key path file
  * @return a valid pointer on success, NULL on error
@@ -103,10 +145,6 @@ static inline SSL_CTX *s_ssl_context_server_new(const char *certificate,
   daemon_return_val_if_fail(certificate, NULL);
   daemon_return_val_if_fail(private_key, NULL);
 
-  SSL_load_error_strings();
-  SSL_library_init();
-  daemon_return_val_if_fail(RAND_poll(), NULL);
-
   SSL_CTX *context = SSL_CTX_new(SSLv23_server_method());
   daemon_return_val_if_fail(context, NULL);
 
@@ -121,7 +159,8 @@ static inline SSL_CTX *s_ssl_context_server_new(const char *certificate,
 }
 
 /**
- * @brief Create a client openssl context
+ * @brief Create a client openssl context, the library must be initialized.
+ * Prefer the shared contexts of ssl-context.h
  * @param certificate: certificate path file
  * @return a valid pointer on success, NULL on error
  */
@@ -129,10 +168,6 @@ static inline SSL_CTX *s_ssl_context_client_new(const char *certificate)
 {
   daemon_return_val_if_fail(certificate, NULL);
 
-  SSL_load_error_strings();
-  SSL_library_init();
-  daemon_return_val_if_fail(RAND_poll(), NULL);
-
   SSL_CTX *context = SSL_CTX_new(SSLv23_client_method());
   daemon_return_val_if_fail(context, NULL);
 
@@ -146,7 +181,8 @@ static inline SSL_CTX *s_ssl_context_client_new(const char *certificate)
 }
 
 /**
- * @brief Deinit openssl/ssl/crypto properly to avoid leaks
+ * @brief Deinit openssl/ssl/crypto properly to avoid leaks. Process wide,
+ * only called by #s_ssl_library_deinit
  */
 static inline void s_ssl_context_deinit(void)
 {